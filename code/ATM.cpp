@@ -6,6 +6,8 @@
 #include <thread>
 #include <utility>
 
+#include "event_count.hpp"
+
 // 简单的消息队列
 namespace messaging {
 struct message_base {
@@ -23,12 +25,18 @@ class queue {
   std::condition_variable c;
   std::queue<std::shared_ptr<message_base>>
       q;  // 实际存储指向message_base的指针
+  event_count* notifier = nullptr;  // 等待多个队列的线程共用，由 m 保护
  public:
   template <typename T>
   void push(const T& msg) {
     std::lock_guard<std::mutex> lk(m);
     q.push(std::make_shared<wrapped_message<T>>(msg));
     c.notify_all();
+    if (notifier) notifier->notify_all();  // 持有锁，见 set_notifier
+  }
+  void set_notifier(event_count* ec) {  // 返回后不会再有 push 访问原来的 ec
+    std::lock_guard<std::mutex> lk(m);
+    notifier = ec;
   }
   std::shared_ptr<message_base> wait_and_pop() {
     std::unique_lock<std::mutex> lk(m);
@@ -37,6 +45,13 @@ class queue {
     q.pop();
     return res;
   }
+  std::shared_ptr<message_base> try_pop() {  // 队列为空时返回空指针
+    std::lock_guard<std::mutex> lk(m);
+    if (q.empty()) return std::shared_ptr<message_base>();
+    auto res = q.front();
+    q.pop();
+    return res;
+  }
 };
 }  // namespace messaging
 
@@ -1,28 +1,143 @@
+#pragma once
+
 #include <atomic>
+#include <cstdint>
 #include <thread>
+#include <vector>
+
+#include "cpu_relax.hpp"
+
+// 等待 generation 离开 gen：多核时先自旋一小段时间，之后在
+// std::atomic::wait 上休眠（Linux 上为 futex），线程数多于核心数时不空转
+inline void wait_for_generation(const std::atomic<unsigned>& generation,
+                                unsigned gen) {
+  // 单核时自旋只会推迟其他线程到达
+  static const int spins = std::thread::hardware_concurrency() > 1 ? 128 : 0;
+  for (int i = 0; i < spins; ++i) {
+    if (generation.load(std::memory_order_acquire) != gen) return;
+    cpu_relax();
+  }
+  while (generation.load(std::memory_order_acquire) == gen) {
+    generation.wait(gen, std::memory_order_acquire);
+  }
+}
+
+class barrier {
+  // 三个计数各占一个缓存行，等待者读 generation 时不受到达者写 spaces 的干扰
+  alignas(64) std::atomic<unsigned> count;       // 需要同步的线程数
+  alignas(64) std::atomic<unsigned> spaces;      // 本轮尚未到达的线程数
+  alignas(64) std::atomic<unsigned> generation;  // 已完成的轮数
+
+  void next_generation() {  // 最后一个到达的线程调用
+    spaces.store(count.load(std::memory_order_relaxed),
+                 std::memory_order_relaxed);  // 重置 spaces 为 count
+    generation.fetch_add(1, std::memory_order_release);
+    generation.notify_all();
+  }
+
+ public:
+  explicit barrier(unsigned n) : count(n), spaces(n), generation(0) {}
+  barrier(const barrier&) = delete;
+  barrier& operator=(const barrier&) = delete;
 
-struct barrier {
-  std::atomic<unsigned> count;       // 需要同步的线程数
-  std::atomic<unsigned> spaces;      // 剩余未到达 barrier 的线程数
-  std::atomic<unsigned> generation;  // 所有线程到达 barrier 的总次数
-  barrier(unsigned n) : count(n), spaces(n), generation(0) {}
   void wait() {
-    const unsigned gen = generation.load();
-    if (!--spaces)  // 递减
-    {
-      spaces = count.load();  // 递减后为 0 则重置 spaces 为 count
-      ++generation;
+    const unsigned gen = generation.load(std::memory_order_acquire);
+    if (spaces.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      next_generation();
     } else {
-      while (generation.load() == gen) {
-        std::this_thread::yield();
+      wait_for_generation(generation, gen);
+    }
+  }
+
+  void done_waiting() {  // 退出同步，之后的每一轮都少等一个线程
+    count.fetch_sub(1, std::memory_order_relaxed);
+    if (spaces.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      next_generation();
+    }
+  }
+};
+
+// 组合树 barrier：线程按编号分组到叶节点，每个节点最多 fan_in 个成员，
+// 一个节点的成员全部到达后再作为一个成员到达父节点，根节点完成即本轮结束。
+// 到达时的竞争分散到多个缓存行，适合线程很多的情况；释放仍是一次广播
+class combining_tree_barrier {
+  struct alignas(64) node {
+    // 高 32 位为需要到达的成员数，低 32 位为本轮已到达的成员数，
+    // 放在一个字中使退出（减少成员数）和到达可以原子地判断本轮是否完成
+    std::atomic<std::uint64_t> state{0};
+    int parent = -1;
+  };
+
+  static constexpr std::uint64_t one_member = std::uint64_t(1) << 32;
+
+  std::vector<node> nodes;  // 先是所有叶节点，最后一个为根节点
+  const unsigned fan_in;
+  alignas(64) std::atomic<unsigned> generation{0};
+
+  // 对节点 i 到达（leave 为 false）或退出（leave 为 true）
+  void arrive(int i, bool leave) {
+    for (;;) {
+      node& x = nodes[i];
+      const std::uint64_t s =
+          leave ? x.state.fetch_sub(one_member, std::memory_order_acq_rel) -
+                      one_member
+                : x.state.fetch_add(1, std::memory_order_acq_rel) + 1;
+      const std::uint64_t members = s >> 32;
+      if ((s & 0xFFFFFFFF) != members) return;  // 还有成员未到达
+      // 本节点本轮完成，在其他成员能再次到达之前清零到达数
+      x.state.store(members << 32, std::memory_order_relaxed);
+      if (x.parent < 0) {
+        generation.fetch_add(1, std::memory_order_release);
+        generation.notify_all();
+        return;
       }
+      leave = members == 0;  // 所有成员都已退出，本节点也从父节点退出
+      i = x.parent;
     }
   }
-  void done_waiting() {  // 供最后一个线程调用
-    --count;
-    if (!--spaces) {
-      spaces = count.load();
-      ++generation;
+
+ public:
+  // n 为参与的线程数，线程编号为 0 ~ n - 1
+  explicit combining_tree_barrier(unsigned n, unsigned fan_in_ = 4)
+      : fan_in(fan_in_ < 2 ? 2 : fan_in_) {
+    std::vector<unsigned> level;  // 当前层每个节点的成员数
+    for (unsigned i = 0; i < n; i += fan_in) {
+      level.push_back(n - i < fan_in ? n - i : fan_in);
+    }
+    std::vector<unsigned> sizes;
+    std::vector<std::size_t> starts;
+    for (;;) {
+      starts.push_back(sizes.size());
+      sizes.insert(sizes.end(), level.begin(), level.end());
+      if (level.size() <= 1) break;
+      const unsigned m = static_cast<unsigned>(level.size());
+      level.clear();
+      for (unsigned i = 0; i < m; i += fan_in) {
+        level.push_back(m - i < fan_in ? m - i : fan_in);
+      }
     }
+    nodes = std::vector<node>(sizes.size());
+    for (std::size_t i = 0; i < sizes.size(); ++i) {
+      nodes[i].state.store(std::uint64_t(sizes[i]) << 32,
+                           std::memory_order_relaxed);
+    }
+    for (std::size_t l = 0; l + 1 < starts.size(); ++l) {
+      for (std::size_t i = starts[l]; i < starts[l + 1]; ++i) {
+        nodes[i].parent =
+            static_cast<int>(starts[l + 1] + (i - starts[l]) / fan_in);
+      }
+    }
+  }
+  combining_tree_barrier(const combining_tree_barrier&) = delete;
+  combining_tree_barrier& operator=(const combining_tree_barrier&) = delete;
+
+  void wait(unsigned id) {
+    const unsigned gen = generation.load(std::memory_order_acquire);
+    arrive(static_cast<int>(id / fan_in), false);
+    wait_for_generation(generation, gen);
+  }
+
+  void done_waiting(unsigned id) {  // 线程 id 退出同步
+    arrive(static_cast<int>(id / fan_in), true);
   }
-};
\ No newline at end of file
+};
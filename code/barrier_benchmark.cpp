@@ -0,0 +1,40 @@
+// barrier、combining_tree_barrier 与 std::barrier 在 2 ~ 64 个线程下
+// 每轮同步的平均耗时
+#include <barrier>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "barrier.hpp"
+
+template <typename F>
+double phase_ns(unsigned threads, unsigned phases, F wait) {
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> v;
+  for (unsigned i = 0; i < threads; ++i) {
+    v.emplace_back([&, i] {
+      for (unsigned j = 0; j < phases; ++j) wait(i);
+    });
+  }
+  for (auto& x : v) x.join();
+  const std::chrono::duration<double, std::nano> d =
+      std::chrono::steady_clock::now() - start;
+  return d.count() / phases;
+}
+
+int main() {
+  const unsigned phases = 2000;
+  std::printf("%8s %16s %16s %16s\n", "threads", "barrier", "tree",
+              "std::barrier");
+  for (unsigned threads : {2, 4, 8, 16, 32, 64}) {
+    barrier a(threads);
+    combining_tree_barrier b(threads);
+    std::barrier<> c(threads);
+    std::printf("%8u %16.0f %16.0f %16.0f\n", threads,
+                phase_ns(threads, phases, [&](unsigned) { a.wait(); }),
+                phase_ns(threads, phases, [&](unsigned i) { b.wait(i); }),
+                phase_ns(threads, phases,
+                         [&](unsigned) { c.arrive_and_wait(); }));
+  }
+}
@@ -0,0 +1,223 @@
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "lock_based_lookup_table.hpp"
+
+// 每个元素的权重默认为 1，即按元素个数限制容量；按字节限制时传入计算大小的函数
+struct unit_weight {
+  template <typename K, typename V>
+  std::size_t operator()(const K&, const V&) const {
+    return 1;
+  }
+};
+
+// 基于 thread_safe_lookup_table 的有界缓存，按分片做 CLOCK 淘汰。
+// 命中时只持有查找表一个桶的共享锁，并无锁地设置访问位，不需要全局链表锁；
+// 插入和淘汰只锁键所在的分片
+template <typename K, typename V, typename Weigher = unit_weight,
+          typename Hash = std::hash<K>>
+class concurrent_cache {
+  struct slot {  // 时钟环上的一个位置
+    std::optional<K> key;               // 为空表示空闲
+    std::atomic<bool> referenced{false};  // 访问位，命中时置位
+    std::size_t weight = 0;
+  };
+
+  struct entry {  // 查找表中存储的值
+    V value;
+    slot* pos;  // 指向时钟环中的位置，std::deque 尾部插入不会使其失效
+  };
+
+  struct alignas(64) shard {
+    std::mutex m;  // 保护下面除计数器以外的成员，命中路径不使用
+    std::deque<slot> ring;
+    std::vector<slot*> free_slots;
+    std::size_t hand = 0;  // 时钟指针
+    std::size_t weight = 0;
+    std::size_t count = 0;
+    // 正在加载的键，同一个键的并发未命中只调用一次 loader
+    std::unordered_map<K, std::shared_future<V>, Hash> inflight;
+    std::atomic<std::uint64_t> hits{0};
+    std::atomic<std::uint64_t> misses{0};
+    std::atomic<std::uint64_t> evictions{0};
+  };
+
+  thread_safe_lookup_table<K, entry, Hash> table;
+  std::unique_ptr<shard[]> shards;
+  const unsigned n;
+  const std::size_t shard_capacity;
+  Weigher weigher;
+  Hash hasher;
+
+  shard& get_shard(const K& k) const { return shards[hasher(k) % n]; }
+
+  std::optional<V> lookup(const K& k) const {
+    std::optional<V> res;
+    table.visit(k, [&](const entry& e) {
+      res = e.value;
+      e.pos->referenced.store(true, std::memory_order_relaxed);
+    });
+    return res;
+  }
+
+  // 转动时钟指针，淘汰访问位为 0 的元素（访问位为 1 则清零，给第二次机会），
+  // 直到能放下 need。调用者持有 s.m，keep 为不能淘汰的位置
+  void evict(shard& s, std::size_t need, const slot* keep) {
+    while (s.weight + need > shard_capacity &&
+           s.count > (keep ? 1u : 0u)) {
+      slot& x = s.ring[s.hand];
+      s.hand = (s.hand + 1) % s.ring.size();
+      if (!x.key || &x == keep) continue;
+      if (x.referenced.exchange(false, std::memory_order_relaxed)) continue;
+      table.remove_mapping(*x.key);
+      x.key.reset();
+      s.weight -= x.weight;
+      --s.count;
+      s.free_slots.push_back(&x);
+      s.evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  void insert(shard& s, const K& k, const V& v) {  // 调用者持有 s.m
+    const std::size_t w = weigher(k, v);
+    slot* pos = nullptr;
+    table.visit(k, [&](const entry& e) { pos = e.pos; });
+    if (pos) {  // 已存在则更新值和权重
+      table.add_or_update_mapping(k, entry{v, pos});
+      s.weight = s.weight - pos->weight + w;
+      pos->weight = w;
+      pos->referenced.store(true, std::memory_order_relaxed);
+      evict(s, 0, pos);
+      return;
+    }
+    evict(s, w, nullptr);
+    if (s.free_slots.empty()) {
+      s.ring.emplace_back();
+      s.free_slots.push_back(&s.ring.back());
+    }
+    pos = s.free_slots.back();
+    table.add_or_update_mapping(k, entry{v, pos});
+    s.free_slots.pop_back();
+    pos->key = k;
+    pos->weight = w;
+    pos->referenced.store(false, std::memory_order_relaxed);
+    s.weight += w;
+    ++s.count;
+  }
+
+ public:
+  struct statistics {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t evictions = 0;
+    std::size_t size = 0;    // 元素个数
+    std::size_t weight = 0;  // 总权重
+  };
+
+  // capacity 为总权重上限，平均分给各个分片；buckets 为查找表的桶数
+  explicit concurrent_cache(std::size_t capacity, unsigned shards_ = 16,
+                            const Weigher& w = Weigher{},
+                            unsigned buckets = 1031, const Hash& h = Hash{})
+      : table(buckets, h),
+        shards(new shard[std::max(1u, shards_)]),
+        n(std::max(1u, shards_)),
+        shard_capacity(std::max<std::size_t>(1, capacity / n)),
+        weigher(w),
+        hasher(h) {}
+  concurrent_cache(const concurrent_cache&) = delete;
+  concurrent_cache& operator=(const concurrent_cache&) = delete;
+
+  bool get(const K& k, V& v) {  // 未命中返回 false
+    shard& s = get_shard(k);
+    std::optional<V> res = lookup(k);
+    if (!res) {
+      s.misses.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    s.hits.fetch_add(1, std::memory_order_relaxed);
+    v = std::move(*res);
+    return true;
+  }
+
+  void put(const K& k, const V& v) {
+    shard& s = get_shard(k);
+    std::lock_guard<std::mutex> l(s.m);
+    insert(s, k, v);
+  }
+
+  void erase(const K& k) {
+    shard& s = get_shard(k);
+    std::lock_guard<std::mutex> l(s.m);
+    slot* pos = nullptr;
+    table.visit(k, [&](const entry& e) { pos = e.pos; });
+    if (!pos) return;
+    table.remove_mapping(k);
+    pos->key.reset();
+    s.weight -= pos->weight;
+    --s.count;
+    s.free_slots.push_back(pos);
+  }
+
+  // 命中则返回缓存的值，否则调用 loader() 加载并放入缓存。
+  // 同一个键的并发未命中只有一个线程调用 loader，其他线程等待其结果，
+  // loader 抛出的异常会传给所有等待的线程
+  template <typename F>
+  V get_or_compute(const K& k, F loader) {
+    shard& s = get_shard(k);
+    if (std::optional<V> res = lookup(k)) {
+      s.hits.fetch_add(1, std::memory_order_relaxed);
+      return std::move(*res);
+    }
+    s.misses.fetch_add(1, std::memory_order_relaxed);
+    std::unique_lock<std::mutex> l(s.m);
+    if (std::optional<V> res = lookup(k)) return std::move(*res);  // 刚加载完
+    auto it = s.inflight.find(k);
+    if (it != s.inflight.end()) {
+      std::shared_future<V> f = it->second;
+      l.unlock();
+      return f.get();
+    }
+    std::promise<V> p;
+    s.inflight.emplace(k, p.get_future().share());
+    l.unlock();
+    try {
+      V v = loader();
+      l.lock();
+      insert(s, k, v);  // 先放入缓存再移除 inflight，之后的查找一定能命中
+      s.inflight.erase(k);
+      l.unlock();
+      p.set_value(v);
+      return v;
+    } catch (...) {
+      if (!l) l.lock();
+      s.inflight.erase(k);
+      l.unlock();
+      p.set_exception(std::current_exception());
+      throw;
+    }
+  }
+
+  statistics stats() const {
+    statistics res;
+    for (unsigned i = 0; i < n; ++i) {
+      shard& s = shards[i];
+      res.hits += s.hits.load(std::memory_order_relaxed);
+      res.misses += s.misses.load(std::memory_order_relaxed);
+      res.evictions += s.evictions.load(std::memory_order_relaxed);
+      std::lock_guard<std::mutex> l(s.m);
+      res.size += s.count;
+      res.weight += s.weight;
+    }
+    return res;
+  }
+};
@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "lock_free_skip_list.hpp"
+
+enum class priority_mode {
+  exact,    // try_pop_min 一定取出当前最小的元素
+  relaxed,  // 取出的元素接近最小，换取更好的扩展性
+};
+
+// 并发优先队列，按 Compare 最小的元素先出（与 std::priority_queue 相反）。
+// exact 模式基于无锁跳表，键为（元素，入队序号），相同优先级的元素先进先出；
+// relaxed 模式是由多个带锁的二叉堆组成的 MultiQueue，push 放入随机的堆，
+// pop 从两个随机的堆中选堆顶较小的一个，期望取出的元素在全局排名的前 O(堆数) 位
+template <typename T, priority_mode Mode = priority_mode::exact,
+          typename Compare = std::less<T>>
+class concurrent_priority_queue {
+  class exact_queue {
+    using key_type = std::pair<T, std::uint64_t>;
+    struct key_compare {
+      Compare comp;
+      bool operator()(const key_type& a, const key_type& b) const {
+        if (comp(a.first, b.first)) return true;
+        if (comp(b.first, a.first)) return false;
+        return a.second < b.second;
+      }
+    };
+    struct empty_value {};
+
+    lock_free_skip_list<key_type, empty_value, key_compare> list;
+    std::atomic<std::uint64_t> ticket{0};  // 使相同的元素可以共存
+
+   public:
+    exact_queue(unsigned, const Compare& c) : list(key_compare{c}) {}
+
+    void push(const T& x) {
+      list.insert(key_type(x, ticket.fetch_add(1, std::memory_order_relaxed)),
+                  empty_value{});
+    }
+
+    std::optional<T> try_pop() {  // 不要求 T 可默认构造
+      std::optional<T> res;
+      list.pop_front_n(1, [&](const key_type& k, const empty_value&) {
+        res.emplace(k.first);
+      });
+      return res;
+    }
+
+    std::size_t try_pop_n(std::size_t k, std::vector<T>& out) {
+      return list.pop_front_n(k, [&](const key_type& x, const empty_value&) {
+        out.push_back(x.first);
+      });
+    }
+
+    bool empty() const { return list.empty(); }
+  };
+
+  class relaxed_queue {
+    struct alignas(64) heap {  // 每个堆独占缓存行，避免伪共享
+      std::mutex m;
+      std::vector<T> data;  // 用 std::push_heap 维护，堆顶为最小元素
+      std::atomic<std::size_t> size{0};
+    };
+
+    std::unique_ptr<heap[]> heaps;
+    const unsigned n;
+    Compare comp;
+
+    static std::minstd_rand& rng() {  // 每个线程各自的随机数引擎
+      thread_local std::minstd_rand r(static_cast<unsigned>(
+          std::hash<std::thread::id>{}(std::this_thread::get_id())));
+      return r;
+    }
+
+    bool greater(const T& a, const T& b) const { return comp(b, a); }
+
+    std::optional<T> pop_top(heap& h) {  // 调用者持有 h.m，h 不为空
+      auto cmp = [this](const T& a, const T& b) { return greater(a, b); };
+      std::pop_heap(h.data.begin(), h.data.end(), cmp);
+      std::optional<T> res(std::move(h.data.back()));
+      h.data.pop_back();
+      h.size.store(h.data.size(), std::memory_order_relaxed);
+      return res;
+    }
+
+   public:
+    relaxed_queue(unsigned n_, const Compare& c)
+        : heaps(new heap[std::max(1u, n_)]), n(std::max(1u, n_)), comp(c) {}
+
+    void push(const T& x) {
+      heap& h = heaps[rng()() % n];
+      std::lock_guard<std::mutex> l(h.m);
+      h.data.push_back(x);
+      std::push_heap(h.data.begin(), h.data.end(),
+                     [this](const T& a, const T& b) { return greater(a, b); });
+      h.size.store(h.data.size(), std::memory_order_relaxed);
+    }
+
+    std::optional<T> try_pop() {
+      for (int attempt = 0; attempt < 4; ++attempt) {
+        heap& a = heaps[rng()() % n];
+        heap& b = heaps[rng()() % n];
+        // 锁被占用说明有竞争者，换两个堆重试，不在这里等待
+        std::unique_lock<std::mutex> la(a.m, std::try_to_lock);
+        if (!la) continue;
+        if (&a == &b || !b.size.load(std::memory_order_relaxed)) {
+          if (!a.data.empty()) return pop_top(a);
+          continue;
+        }
+        std::unique_lock<std::mutex> lb(b.m, std::try_to_lock);
+        if (!lb) {
+          if (!a.data.empty()) return pop_top(a);
+          continue;
+        }
+        if (a.data.empty() && b.data.empty()) continue;
+        if (b.data.empty() ||
+            (!a.data.empty() && !comp(b.data.front(), a.data.front()))) {
+          return pop_top(a);
+        }
+        return pop_top(b);
+      }
+      // 随机选择多次失败，依次检查所有堆，保证有元素时一定能取到
+      const unsigned start = rng()() % n;
+      for (unsigned i = 0; i < n; ++i) {
+        heap& h = heaps[(start + i) % n];
+        if (!h.size.load(std::memory_order_relaxed)) continue;
+        std::lock_guard<std::mutex> l(h.m);
+        if (!h.data.empty()) return pop_top(h);
+      }
+      return std::nullopt;
+    }
+
+    // 同时锁住两个随机的堆，按顺序合并两者的堆顶取出至多 k 个元素，
+    // 每一批只加一次锁，取出的元素与 try_pop 一样接近最小
+    std::size_t try_pop_n(std::size_t k, std::vector<T>& out) {
+      std::size_t got = 0;
+      for (int attempt = 0; attempt < 4 && !got; ++attempt) {
+        heap& a = heaps[rng()() % n];
+        heap& b = heaps[rng()() % n];
+        std::unique_lock<std::mutex> la(a.m, std::try_to_lock);
+        if (!la) continue;
+        std::unique_lock<std::mutex> lb;
+        if (&a != &b) lb = std::unique_lock<std::mutex>(b.m, std::try_to_lock);
+        heap* other = lb ? &b : nullptr;
+        while (got < k) {
+          heap* h = &a;
+          if (other && !other->data.empty() &&
+              (a.data.empty() || comp(other->data.front(), a.data.front()))) {
+            h = other;
+          }
+          if (h->data.empty()) break;
+          out.push_back(std::move(*pop_top(*h)));
+          ++got;
+        }
+      }
+      if (got) return got;
+      // 与 try_pop 一样，随机选择多次失败后依次检查所有堆
+      const unsigned start = rng()() % n;
+      for (unsigned i = 0; i < n && got < k; ++i) {
+        heap& h = heaps[(start + i) % n];
+        if (!h.size.load(std::memory_order_relaxed)) continue;
+        std::lock_guard<std::mutex> l(h.m);
+        while (got < k && !h.data.empty()) {
+          out.push_back(std::move(*pop_top(h)));
+          ++got;
+        }
+      }
+      return got;
+    }
+
+    bool empty() const {
+      for (unsigned i = 0; i < n; ++i) {
+        if (heaps[i].size.load(std::memory_order_relaxed)) return false;
+      }
+      return true;
+    }
+  };
+
+  std::conditional_t<Mode == priority_mode::exact, exact_queue, relaxed_queue>
+      q;
+
+ public:
+  // heaps 只对 relaxed 模式有效，为内部堆的个数，默认为核心数的两倍
+  explicit concurrent_priority_queue(
+      const Compare& c = Compare{},
+      unsigned heaps = 2 * std::max(1u, std::thread::hardware_concurrency()))
+      : q(heaps, c) {}
+  concurrent_priority_queue(const concurrent_priority_queue&) = delete;
+  concurrent_priority_queue& operator=(const concurrent_priority_queue&) =
+      delete;
+
+  void push(const T& x) { q.push(x); }
+
+  bool try_pop_min(T& x) {  // 为空时返回 false
+    std::optional<T> res = q.try_pop();
+    if (!res) return false;
+    x = std::move(*res);
+    return true;
+  }
+
+  std::optional<T> try_pop_min() { return q.try_pop(); }
+
+  // 批量取出至多 n 个元素追加到 out，返回取出的个数。
+  // exact 模式沿跳表底层一次扫过并删除最小的 n 个元素，取出的元素有序；
+  // relaxed 模式每批只锁一对堆。添加到 out 时抛出异常，已删除的元素可能丢失
+  std::size_t pop_min_n(std::size_t n, std::vector<T>& out) {
+    return q.try_pop_n(n, out);
+  }
+
+  bool empty() const { return q.empty(); }
+};
@@ -0,0 +1,68 @@
+// concurrent_priority_queue 两种模式与互斥量保护的 std::priority_queue 的
+// 吞吐量对比，每个线程交替执行 push 随机优先级和 pop_min
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "concurrent_priority_queue.hpp"
+
+class locked_heap {
+  std::priority_queue<int, std::vector<int>, std::greater<int>> q;
+  std::mutex m;
+
+ public:
+  void push(const int& x) {
+    std::lock_guard<std::mutex> l(m);
+    q.push(x);
+  }
+  bool try_pop_min(int& x) {
+    std::lock_guard<std::mutex> l(m);
+    if (q.empty()) return false;
+    x = q.top();
+    q.pop();
+    return true;
+  }
+};
+
+template <typename Queue>
+double throughput(unsigned threads, std::size_t per_thread) {
+  Queue q;
+  std::mt19937 init(1);
+  for (int i = 0; i < 10000; ++i) q.push(int(init() % 1000000));
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> v;
+  for (unsigned i = 0; i < threads; ++i) {
+    v.emplace_back([&, i] {
+      std::mt19937 r(i);
+      int x;
+      for (std::size_t j = 0; j < per_thread; ++j) {
+        q.push(int(r() % 1000000));
+        q.try_pop_min(x);
+      }
+    });
+  }
+  for (auto& x : v) x.join();
+  const std::chrono::duration<double> d =
+      std::chrono::steady_clock::now() - start;
+  return 2.0 * threads * per_thread / d.count();
+}
+
+int main() {
+  const std::size_t total = 1 << 19;
+  std::printf("%8s %16s %16s %16s\n", "threads", "mutex heap", "exact",
+              "relaxed");
+  for (unsigned threads : {1, 2, 4, 8, 16, 32, 64}) {
+    const std::size_t per_thread = total / threads;
+    std::printf(
+        "%8u %16.0f %16.0f %16.0f\n", threads,
+        throughput<locked_heap>(threads, per_thread),
+        throughput<concurrent_priority_queue<int>>(threads, per_thread),
+        throughput<concurrent_priority_queue<int, priority_mode::relaxed>>(
+            threads, per_thread));
+  }
+}
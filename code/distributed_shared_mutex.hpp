@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>  // for std::bit_ceil
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "thread_index.hpp"
+
+// 分布式读写锁：读者计数分散到多个槽，每个槽独占一个缓存行，
+// 线程按编号固定使用一个槽，不同核心上的读者不再争抢同一个缓存行。
+// 写者先设置标志阻止新读者进入，再等所有槽归零，写者之间用 wm 互斥。
+// 接口与 std::shared_mutex 相同，可以直接用于 std::shared_lock 等。
+// 代价是每个锁占用 槽数 × 64 字节，写者需要扫描所有槽，适合读远多于写的场景
+class distributed_shared_mutex {
+  struct alignas(64) slot {
+    std::atomic<long> readers{0};
+  };
+
+  std::unique_ptr<slot[]> slots;
+  const unsigned n;  // 槽数，为 2 的幂
+  alignas(64) std::atomic<bool> writer{false};
+  std::mutex wm;
+
+  static unsigned default_slots() {
+    unsigned res = 1;
+    const unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+    while (res < hw && res < 64) res *= 2;
+    return res;
+  }
+
+  std::atomic<long>& my_slot() const {
+    return slots[thread_index::get() & (n - 1)].readers;
+  }
+
+ public:
+  // 槽数取不小于 n_ 的 2 的幂，默认按核心数，最多 64
+  explicit distributed_shared_mutex(unsigned n_ = default_slots())
+      : slots(new slot[std::bit_ceil(std::max(1u, n_))]),
+        n(std::bit_ceil(std::max(1u, n_))) {}
+  distributed_shared_mutex(const distributed_shared_mutex&) = delete;
+  distributed_shared_mutex& operator=(const distributed_shared_mutex&) =
+      delete;
+
+  void lock_shared() {
+    std::atomic<long>& s = my_slot();
+    for (;;) {
+      // 先登记再检查写者，写者先设标志再检查槽（都是 seq_cst），
+      // 两者至少有一方能看到对方
+      s.fetch_add(1);
+      if (!writer.load()) return;
+      s.fetch_sub(1, std::memory_order_release);
+      writer.wait(true);  // 写者释放后重试
+    }
+  }
+
+  bool try_lock_shared() {
+    std::atomic<long>& s = my_slot();
+    s.fetch_add(1);
+    if (!writer.load()) return true;
+    s.fetch_sub(1, std::memory_order_release);
+    return false;
+  }
+
+  void unlock_shared() { my_slot().fetch_sub(1, std::memory_order_release); }
+
+  void lock() {
+    wm.lock();
+    writer.store(true);
+    for (unsigned i = 0; i < n; ++i) {  // 等已进入的读者全部离开
+      while (slots[i].readers.load()) std::this_thread::yield();
+    }
+  }
+
+  bool try_lock() {
+    if (!wm.try_lock()) return false;
+    writer.store(true);
+    for (unsigned i = 0; i < n; ++i) {
+      if (slots[i].readers.load()) {
+        unlock();
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void unlock() {
+    writer.store(false, std::memory_order_release);
+    writer.notify_all();
+    wm.unlock();
+  }
+};
@@ -0,0 +1,95 @@
+// distributed_shared_mutex 与 std::shared_mutex 在 1 ~ 64 个读者下的
+// 吞吐量对比，分别测只读和附带一个写者（每秒约一千次写）两种负载
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "distributed_shared_mutex.hpp"
+#include "lock_based_lookup_table.hpp"
+
+template <typename Mutex>
+double read_throughput(unsigned readers, bool with_writer) {
+  Mutex m;
+  long shared_value = 0;
+  std::atomic<bool> stop(false);
+  std::atomic<long> total(0);
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < readers; ++i) {
+    threads.emplace_back([&] {
+      long n = 0;
+      [[maybe_unused]] volatile long sink = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        std::shared_lock<Mutex> l(m);
+        sink = shared_value;
+        ++n;
+      }
+      total.fetch_add(n);
+    });
+  }
+  if (with_writer) {
+    threads.emplace_back([&] {
+      while (!stop.load(std::memory_order_relaxed)) {
+        {
+          std::lock_guard<Mutex> l(m);
+          ++shared_value;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    });
+  }
+  const auto d = std::chrono::milliseconds(200);
+  std::this_thread::sleep_for(d);
+  stop = true;
+  for (auto& x : threads) x.join();
+  return total.load() / std::chrono::duration<double>(d).count();
+}
+
+// 查找表的 visit 使用桶的共享锁，std::string 键不能走无锁的乐观读
+template <typename Mutex>
+double table_throughput(unsigned readers) {
+  thread_safe_lookup_table<std::string, int, std::hash<std::string>,
+                           std::equal_to<std::string>, Mutex>
+      t(19);
+  for (int i = 0; i < 64; ++i) t.add_or_update_mapping(std::to_string(i), i);
+  std::atomic<bool> stop(false);
+  std::atomic<long> total(0);
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < readers; ++i) {
+    threads.emplace_back([&, i] {
+      const std::string k = std::to_string(i % 4);  // 热点键
+      long n = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        t.visit(k, [&](int) { ++n; });
+      }
+      total.fetch_add(n);
+    });
+  }
+  const auto d = std::chrono::milliseconds(200);
+  std::this_thread::sleep_for(d);
+  stop = true;
+  for (auto& x : threads) x.join();
+  return total.load() / std::chrono::duration<double>(d).count();
+}
+
+int main() {
+  std::printf("%8s %8s %16s %16s\n", "readers", "writer", "shared_mutex",
+              "distributed");
+  for (unsigned readers : {1, 2, 4, 8, 16, 32, 64}) {
+    for (bool w : {false, true}) {
+      std::printf("%8u %8s %16.0f %16.0f\n", readers, w ? "yes" : "no",
+                  read_throughput<std::shared_mutex>(readers, w),
+                  read_throughput<distributed_shared_mutex>(readers, w));
+    }
+  }
+  std::printf("\nlookup table visit() on hot keys\n");
+  for (unsigned readers : {1, 2, 4, 8, 16, 32, 64}) {
+    std::printf("%8u %8s %16.0f %16.0f\n", readers, "no",
+                table_throughput<std::shared_mutex>(readers),
+                table_throughput<distributed_shared_mutex>(readers));
+  }
+}
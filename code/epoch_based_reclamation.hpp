@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "thread_index.hpp"
+
+// 基于纪元的内存回收（EBR）：线程访问共享节点前进入临界区，记下当时的全局纪元；
+// 摘除的节点连同摘除时的纪元放入本线程的待回收列表。所有处于临界区的线程
+// 都已看到当前纪元时，全局纪元才能前进，因此节点在纪元前进两次后
+// 不可能再被任何线程持有，可以释放。
+// 与风险指针相比，读者只需在进出临界区时各写一次自己的纪元，不必每个节点都发布
+class epoch_domain {
+  static constexpr unsigned chunk_size = 64;
+  static constexpr unsigned max_chunks = 64;  // 最多支持 4096 个同时存在的线程
+  static constexpr std::size_t collect_threshold = 64;
+
+  struct retired_node {
+    std::uint64_t epoch;
+    void* p;
+    void (*deleter)(void*);
+  };
+
+  // 每个线程编号对应一个记录，只有持有该编号的线程会修改 nesting 和 retired
+  struct alignas(64) record {
+    std::atomic<std::uint64_t> local{0};  // 纪元 * 2 + 1，不在临界区时为 0
+    unsigned nesting = 0;
+    std::vector<retired_node> retired;
+  };
+
+  alignas(64) std::atomic<std::uint64_t> global{0};
+  std::atomic<record*> chunks[max_chunks] = {};
+  std::atomic<unsigned> used_chunks{0};  // 已分配的块数的上界
+
+  record& get_record() {
+    const unsigned i = thread_index::get();
+    if (i >= chunk_size * max_chunks) {
+      throw std::length_error("epoch_domain: too many threads");
+    }
+    std::atomic<record*>& c = chunks[i / chunk_size];
+    record* p = c.load(std::memory_order_acquire);
+    if (!p) {
+      record* np = new record[chunk_size];
+      if (c.compare_exchange_strong(p, np, std::memory_order_acq_rel)) {
+        p = np;
+      } else {
+        delete[] np;
+      }
+      unsigned n = used_chunks.load();
+      while (n < i / chunk_size + 1 &&
+             !used_chunks.compare_exchange_weak(n, i / chunk_size + 1)) {
+      }
+    }
+    return p[i % chunk_size];
+  }
+
+  bool try_advance() {  // 所有临界区内的线程都已看到当前纪元时前进一步
+    std::uint64_t g = global.load();
+    const unsigned n = used_chunks.load();
+    for (unsigned i = 0; i < n; ++i) {
+      const record* p = chunks[i].load(std::memory_order_acquire);
+      if (!p) continue;
+      for (unsigned j = 0; j < chunk_size; ++j) {
+        const std::uint64_t x = p[j].local.load();
+        if ((x & 1) && (x >> 1) != g) return false;
+      }
+    }
+    return global.compare_exchange_strong(g, g + 1);
+  }
+
+  static void collect(record& r, std::uint64_t g) {  // 释放两个纪元以前的节点
+    std::size_t i = 0;
+    while (i < r.retired.size() && r.retired[i].epoch + 2 <= g) {
+      r.retired[i].deleter(r.retired[i].p);
+      ++i;
+    }
+    r.retired.erase(r.retired.begin(), r.retired.begin() + i);
+  }
+
+ public:
+  epoch_domain() = default;
+  epoch_domain(const epoch_domain&) = delete;
+  epoch_domain& operator=(const epoch_domain&) = delete;
+  ~epoch_domain() {  // 调用时不能再有线程使用本域
+    for (auto& c : chunks) {
+      record* p = c.load();
+      if (!p) continue;
+      for (unsigned j = 0; j < chunk_size; ++j) {
+        for (auto& x : p[j].retired) x.deleter(x.p);
+      }
+      delete[] p;
+    }
+  }
+
+  void enter() {  // 可以嵌套
+    record& r = get_record();
+    if (r.nesting++) return;
+    for (;;) {
+      const std::uint64_t e = global.load();
+      r.local.store(e * 2 + 1);
+      // 发布后全局纪元未变，之后 try_advance 一定能看到本线程
+      if (global.load() == e) return;
+    }
+  }
+
+  void exit() {
+    record& r = get_record();
+    if (--r.nesting == 0) r.local.store(0, std::memory_order_release);
+  }
+
+  // 节点已从数据结构中摘除，等到没有线程可能持有它时调用 deleter(p)
+  void retire(void* p, void (*deleter)(void*)) {
+    record& r = get_record();
+    r.retired.push_back(retired_node{global.load(), p, deleter});
+    if (r.retired.size() % collect_threshold == 0) {
+      try_advance();
+      collect(r, global.load());
+    }
+  }
+
+  template <typename T>
+  void retire(T* p) {
+    retire(p, [](void* x) { delete static_cast<T*>(x); });
+  }
+};
+
+class epoch_guard {  // 在作用域内处于 epoch_domain 的临界区
+  epoch_domain& d;
+
+ public:
+  explicit epoch_guard(epoch_domain& x) : d(x) { d.enter(); }
+  epoch_guard(const epoch_guard&) = delete;
+  epoch_guard& operator=(const epoch_guard&) = delete;
+  ~epoch_guard() { d.exit(); }
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+// eventcount：多个队列共享一个通知器，一个线程可以等待其中任意一个有数据
+// 等待方的用法：
+//   auto key = ec.prepare_wait();
+//   if (检查条件成立) { ec.cancel_wait(); ... } else { ec.commit_wait(key); }
+// 通知方在使条件成立之后调用 notify_all，没有等待者时只有一次 fence 和 load
+class event_count {
+  std::atomic<std::uint64_t> epoch{0};  // 每次通知递增
+  std::atomic<unsigned> waiters{0};     // 已调用 prepare_wait 的线程数
+  std::mutex m;                         // 只在有等待者时使用
+  std::condition_variable cv;
+
+ public:
+  event_count() = default;
+  event_count(const event_count&) = delete;
+  event_count& operator=(const event_count&) = delete;
+
+  std::uint64_t prepare_wait() {
+    waiters.fetch_add(1);
+    // 与 notify_all 中的 fence 配对：通知方要么看到 waiters 不为零，
+    // 要么等待方之后的检查能看到通知方写入的数据
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return epoch.load();
+  }
+
+  void cancel_wait() { waiters.fetch_sub(1); }
+
+  void commit_wait(std::uint64_t key) {
+    std::unique_lock<std::mutex> l(m);
+    cv.wait(l, [&] { return epoch.load() != key; });
+    waiters.fetch_sub(1);
+  }
+
+  template <typename Clock, typename Duration>
+  bool commit_wait_until(  // 超时返回 false
+      std::uint64_t key,
+      const std::chrono::time_point<Clock, Duration>& deadline) {
+    std::unique_lock<std::mutex> l(m);
+    const bool res =
+        cv.wait_until(l, deadline, [&] { return epoch.load() != key; });
+    waiters.fetch_sub(1);
+    return res;
+  }
+
+  void notify_all() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!waiters.load(std::memory_order_relaxed)) return;
+    {
+      std::lock_guard<std::mutex> l(m);  // 避免等待方检查完 epoch 后错过通知
+      epoch.fetch_add(1);
+    }
+    cv.notify_all();
+  }
+};
@@ -0,0 +1,157 @@
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "lock_based_stack.hpp"  // for emptyStack
+#include "thread_index.hpp"
+
+// 平面合并（flat combining）的栈：线程把操作写到自己的发布记录中，
+// 抢到合并锁的线程一次性执行所有记录中待处理的操作，其他线程只需等待结果。
+// 栈的数据始终只被合并者访问，留在其缓存中，锁的争用也从每个操作一次
+// 降为每一批一次。线程编号超出记录数时退化为直接加锁执行
+template <typename T>
+class flat_combining_stack {
+  enum : int { idle, push_op, pop_op, done };
+
+  struct alignas(64) record {
+    std::atomic<int> state{idle};
+    std::optional<T> value;  // push 的参数或 pop 的结果
+    std::exception_ptr error;  // 合并者执行该操作时抛出的异常
+  };
+
+  static constexpr unsigned max_records = 128;
+
+  std::vector<T> data;  // 只由持有合并锁的线程访问
+  std::unique_ptr<record[]> records;
+  std::atomic<unsigned> used{0};  // 已使用的记录数的上界
+  alignas(64) std::atomic<bool> combining{false};
+  std::atomic<std::size_t> size{0};
+
+  bool try_lock() {
+    return !combining.load(std::memory_order_relaxed) &&
+           !combining.exchange(true, std::memory_order_acquire);
+  }
+  void unlock() { combining.store(false, std::memory_order_release); }
+
+  void apply(record& r) {  // 持有合并锁
+    if (r.state.load(std::memory_order_relaxed) == push_op) {
+      data.push_back(std::move(*r.value));
+      r.value.reset();
+    } else if (!data.empty()) {
+      r.value.emplace(std::move(data.back()));
+      data.pop_back();
+    }
+  }
+
+  void combine() {  // 持有合并锁，执行所有待处理的操作
+    const unsigned n = used.load(std::memory_order_acquire);
+    for (unsigned i = 0; i < n; ++i) {
+      record& r = records[i];
+      const int s = r.state.load(std::memory_order_acquire);
+      if (s != push_op && s != pop_op) continue;
+      try {  // 异常交给发起操作的线程，合并者继续处理其他记录
+        apply(r);
+      } catch (...) {
+        r.error = std::current_exception();
+      }
+      r.state.store(done, std::memory_order_release);
+    }
+    size.store(data.size(), std::memory_order_relaxed);
+  }
+
+  // 发布操作并等待完成，返回时 r.value 为 pop 的结果
+  void execute(record& r, int op) {
+    r.state.store(op, std::memory_order_release);
+    for (unsigned spins = 0;; ++spins) {
+      if (try_lock()) {
+        combine();  // 自己的操作一定在这一批中
+        unlock();
+      }
+      if (r.state.load(std::memory_order_acquire) == done) break;
+      if (spins > 64) std::this_thread::yield();
+    }
+    r.state.store(idle, std::memory_order_relaxed);
+    if (r.error) {
+      r.value.reset();  // 失败的 push 留下的参数不能成为之后 pop 的结果
+      std::rethrow_exception(std::exchange(r.error, nullptr));
+    }
+  }
+
+  record* my_record() {
+    const unsigned i = thread_index::get();
+    if (i >= max_records) return nullptr;
+    unsigned n = used.load(std::memory_order_relaxed);
+    while (n <= i && !used.compare_exchange_weak(n, i + 1)) {
+    }
+    return &records[i];
+  }
+
+  std::optional<T> pop_impl() {
+    if (record* r = my_record()) {
+      execute(*r, pop_op);
+      std::optional<T> res(std::move(r->value));
+      r->value.reset();
+      return res;
+    }
+    record tmp;  // 没有空闲的记录，直接在锁内执行
+    tmp.state.store(pop_op, std::memory_order_relaxed);
+    while (!try_lock()) std::this_thread::yield();
+    if (!data.empty()) {  // 移出元素不抛异常时不会失败
+      tmp.value.emplace(std::move(data.back()));
+      data.pop_back();
+    }
+    size.store(data.size(), std::memory_order_relaxed);
+    unlock();
+    return std::move(tmp.value);
+  }
+
+ public:
+  flat_combining_stack() : records(new record[max_records]) {}
+  flat_combining_stack(const flat_combining_stack&) = delete;
+  flat_combining_stack& operator=(const flat_combining_stack&) = delete;
+
+  void push(T n) {
+    if (record* r = my_record()) {
+      r->value.emplace(std::move(n));
+      execute(*r, push_op);
+      return;
+    }
+    while (!try_lock()) std::this_thread::yield();
+    try {
+      data.push_back(std::move(n));
+    } catch (...) {
+      unlock();
+      throw;
+    }
+    size.store(data.size(), std::memory_order_relaxed);
+    unlock();
+  }
+
+  std::shared_ptr<T> pop() {  // 栈为空时抛出 emptyStack
+    std::optional<T> res = pop_impl();
+    if (!res) throw emptyStack();
+    return std::make_shared<T>(std::move(*res));
+  }
+
+  void pop(T& n) {
+    std::optional<T> res = pop_impl();
+    if (!res) throw emptyStack();
+    n = std::move(*res);
+  }
+
+  bool try_pop(T& n) {  // 栈为空时返回 false，不抛异常
+    std::optional<T> res = pop_impl();
+    if (!res) return false;
+    n = std::move(*res);
+    return true;
+  }
+
+  std::optional<T> try_pop() { return pop_impl(); }
+
+  bool empty() const { return size.load(std::memory_order_relaxed) == 0; }
+};
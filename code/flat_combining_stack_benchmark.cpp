@@ -0,0 +1,52 @@
+// flat_combining_stack 与 thread_safe_stack、lock_free_stack 的吞吐量对比，
+// 每个线程交替执行 push 和 pop，栈在 pop 时总不为空
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "flat_combining_stack.hpp"
+#include "lock_based_stack.hpp"
+#include "lock_free_stack.hpp"
+
+template <typename Stack, typename Pop>
+double throughput(unsigned threads, std::size_t per_thread, Pop pop) {
+  Stack s;
+  for (int i = 0; i < 1024; ++i) s.push(i);
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> v;
+  for (unsigned i = 0; i < threads; ++i) {
+    v.emplace_back([&] {
+      for (std::size_t j = 0; j < per_thread; ++j) {
+        s.push(int(j));
+        pop(s);
+      }
+    });
+  }
+  for (auto& x : v) x.join();
+  const std::chrono::duration<double> d =
+      std::chrono::steady_clock::now() - start;
+  return 2.0 * threads * per_thread / d.count();
+}
+
+int main() {
+  const std::size_t total = 1 << 20;
+  std::printf("%8s %16s %16s %16s\n", "threads", "mutex", "flat combining",
+              "lock free");
+  for (unsigned threads : {1, 2, 4, 8, 16, 32, 64}) {
+    const std::size_t per_thread = total / threads;
+    const double a = throughput<thread_safe_stack<int>>(
+        threads, per_thread, [](auto& s) {
+          int x;
+          s.try_pop(x);
+        });
+    const double b = throughput<flat_combining_stack<int>>(
+        threads, per_thread, [](auto& s) {
+          int x;
+          s.try_pop(x);
+        });
+    const double c = throughput<lock_free_stack<int>>(
+        threads, per_thread, [](auto& s) { s.pop(); });
+    std::printf("%8u %16.0f %16.0f %16.0f\n", threads, a, b, c);
+  }
+}
@@ -0,0 +1,267 @@
+#include <climits>  // for ULONG_MAX
+#include <mutex>
+#include <stdexcept>
+#if defined(HIERARCHICAL_MUTEX_PROFILE)
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <iterator>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#endif
+
+// 层级锁有三种构建模式：
+//   默认：每次加锁检查层级，违反时抛出 std::logic_error
+//   定义 HIERARCHICAL_MUTEX_DISABLE_CHECKS：不做任何检查，等同于 std::mutex
+//   定义 HIERARCHICAL_MUTEX_PROFILE：不抛异常，记录实际的加锁顺序图、
+//     每个锁的等待和持有时间，程序退出时输出其中的环（潜在死锁）、
+//     违反层级的次数和等待时间最长的锁，适合在测试环境中发现加锁顺序问题
+
+#if defined(HIERARCHICAL_MUTEX_DISABLE_CHECKS)
+
+class hierarchical_mutex {
+  std::mutex internal_mutex;
+
+ public:
+  explicit hierarchical_mutex(unsigned long, const char* = nullptr) {}
+  void lock() { internal_mutex.lock(); }
+  void unlock() { internal_mutex.unlock(); }
+  bool try_lock() { return internal_mutex.try_lock(); }
+};
+
+#else
+
+#if defined(HIERARCHICAL_MUTEX_PROFILE)
+namespace hierarchical_mutex_profile {
+
+struct lock_stats {
+  std::string name;
+  unsigned long value;
+  std::atomic<std::uint64_t> acquisitions{0};
+  std::atomic<std::uint64_t> contended{0};  // 需要等待的次数
+  std::atomic<std::uint64_t> wait_ns{0};
+  std::atomic<std::uint64_t> max_wait_ns{0};
+  std::atomic<std::uint64_t> hold_ns{0};
+  lock_stats(std::string n, unsigned long v) : name(std::move(n)), value(v) {}
+};
+
+// 所有锁的统计和加锁顺序图，析构（程序退出）时输出报告
+class registry {
+  std::mutex m;
+  std::deque<lock_stats> locks;  // 下标为锁的编号，锁销毁后统计仍保留
+  std::set<std::pair<unsigned, unsigned>> edges;  // 持有 first 时获取 second
+  std::atomic<std::uint64_t> violations{0};
+
+  std::string describe(unsigned id) const {
+    return locks[id].name + "(" + std::to_string(locks[id].value) + ")";
+  }
+
+  // 深度优先搜索，遇到仍在栈上的节点即为一个环
+  void find_cycles(std::vector<std::vector<unsigned>>& cycles) const {
+    const std::size_t n = locks.size();
+    std::vector<std::vector<unsigned>> adj(n);
+    for (auto& e : edges) adj[e.first].push_back(e.second);
+    std::vector<int> color(n, 0);  // 0 未访问，1 在栈上，2 已完成
+    std::vector<std::pair<unsigned, std::size_t>> stack;  // 节点，下一条边
+    for (unsigned s = 0; s < n && cycles.size() < 16; ++s) {
+      if (color[s]) continue;
+      stack.emplace_back(s, 0);
+      color[s] = 1;
+      while (!stack.empty()) {
+        auto& [u, i] = stack.back();
+        if (i == adj[u].size()) {
+          color[u] = 2;
+          stack.pop_back();
+          continue;
+        }
+        const unsigned v = adj[u][i++];
+        if (color[v] == 0) {
+          color[v] = 1;
+          stack.emplace_back(v, 0);
+        } else if (color[v] == 1 && cycles.size() < 16) {
+          std::vector<unsigned> c;
+          auto it = std::find_if(stack.begin(), stack.end(),
+                                 [&](auto& x) { return x.first == v; });
+          for (; it != stack.end(); ++it) c.push_back(it->first);
+          c.push_back(v);
+          cycles.push_back(std::move(c));
+        }
+      }
+    }
+  }
+
+ public:
+  static registry& get() {
+    static registry r;  // 在第一个锁构造时构造，在所有静态的锁之后析构
+    return r;
+  }
+
+  lock_stats* add(const char* name, unsigned long value, unsigned& id) {
+    std::lock_guard<std::mutex> l(m);
+    id = static_cast<unsigned>(locks.size());
+    locks.emplace_back(name ? name : "mutex#" + std::to_string(id), value);
+    return &locks.back();
+  }
+
+  void add_edge(unsigned from, unsigned to) {
+    std::lock_guard<std::mutex> l(m);
+    edges.emplace(from, to);
+  }
+
+  void add_violation() { violations.fetch_add(1, std::memory_order_relaxed); }
+
+  void report(std::ostream& os) {
+    std::lock_guard<std::mutex> l(m);
+    os << "hierarchical_mutex profile: " << locks.size() << " locks, "
+       << edges.size() << " lock order edges, " << violations.load()
+       << " hierarchy violations\n";
+    std::vector<std::vector<unsigned>> cycles;
+    find_cycles(cycles);
+    for (auto& c : cycles) {
+      os << "  lock order cycle: ";
+      for (std::size_t i = 0; i < c.size(); ++i) {
+        os << (i ? " -> " : "") << describe(c[i]);
+      }
+      os << '\n';
+    }
+    std::vector<const lock_stats*> hot;
+    for (auto& x : locks) {
+      if (x.contended.load()) hot.push_back(&x);
+    }
+    std::sort(hot.begin(), hot.end(), [](auto a, auto b) {
+      return a->wait_ns.load() > b->wait_ns.load();
+    });
+    if (hot.size() > 10) hot.resize(10);
+    for (auto x : hot) {
+      os << "  hot lock " << x->name << '(' << x->value
+         << "): acquisitions=" << x->acquisitions.load()
+         << " contended=" << x->contended.load()
+         << " wait_ms=" << x->wait_ns.load() / 1e6
+         << " max_wait_us=" << x->max_wait_ns.load() / 1e3
+         << " hold_ms=" << x->hold_ns.load() / 1e6 << '\n';
+    }
+  }
+
+  ~registry() { report(std::cerr); }
+};
+
+}  // namespace hierarchical_mutex_profile
+#endif
+
+class hierarchical_mutex {
+  std::mutex internal_mutex;
+  const unsigned long hierarchy_value;     // 当前层级值
+  unsigned long previous_hierarchy_value;  // 前一线程的层级值
+  // 所在线程的层级值，thread_local表示值存在于线程存储期，
+  // 初始化为ULONG_MAX以使构造锁时能通过检查
+  static inline thread_local unsigned long this_thread_hierarchy_value =
+      ULONG_MAX;
+
+#if defined(HIERARCHICAL_MUTEX_PROFILE)
+  using clock = std::chrono::steady_clock;
+  unsigned id;
+  hierarchical_mutex_profile::lock_stats* stats;
+  clock::time_point acquired;  // 只由持有者读写
+  static inline thread_local std::vector<const hierarchical_mutex*> held;
+  // 本线程已上报过的边，避免每次加锁都访问全局的图
+  static inline thread_local std::set<std::pair<unsigned, unsigned>> seen;
+
+  void check_for_hierarchy_violation() {  // 只记录，不抛异常
+    if (this_thread_hierarchy_value <= hierarchy_value) {
+      hierarchical_mutex_profile::registry::get().add_violation();
+    }
+    for (const hierarchical_mutex* x : held) {
+      if (seen.emplace(x->id, id).second) {
+        hierarchical_mutex_profile::registry::get().add_edge(x->id, id);
+      }
+    }
+  }
+
+  void on_acquired() {
+    acquired = clock::now();
+    stats->acquisitions.fetch_add(1, std::memory_order_relaxed);
+    held.push_back(this);
+  }
+
+  void lock_internal() {
+    if (internal_mutex.try_lock()) return;  // 未竞争时不计时
+    const auto start = clock::now();
+    internal_mutex.lock();
+    const std::uint64_t ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() -
+                                                             start)
+            .count();
+    stats->contended.fetch_add(1, std::memory_order_relaxed);
+    stats->wait_ns.fetch_add(ns, std::memory_order_relaxed);
+    std::uint64_t old = stats->max_wait_ns.load(std::memory_order_relaxed);
+    while (old < ns && !stats->max_wait_ns.compare_exchange_weak(old, ns)) {
+    }
+  }
+#else
+  void check_for_hierarchy_violation() {  // 检查是否违反层级结构
+    if (this_thread_hierarchy_value <= hierarchy_value) {
+      throw std::logic_error("mutex hierarchy violated");
+    }
+  }
+  void on_acquired() {}
+  void lock_internal() { internal_mutex.lock(); }
+#endif
+
+  void update_hierarchy_value() {
+    // 先存储当前线程的层级值（用于解锁时恢复）
+    previous_hierarchy_value = this_thread_hierarchy_value;
+    // 再把其设为锁的层级值
+    this_thread_hierarchy_value = hierarchy_value;
+  }
+
+ public:
+  // name 只在 HIERARCHICAL_MUTEX_PROFILE 模式下用于报告
+  explicit hierarchical_mutex(unsigned long value,
+                              [[maybe_unused]] const char* name = nullptr)
+      : hierarchy_value(value), previous_hierarchy_value(0) {
+#if defined(HIERARCHICAL_MUTEX_PROFILE)
+    stats = hierarchical_mutex_profile::registry::get().add(name, value, id);
+#endif
+  }
+  void lock() {
+    check_for_hierarchy_violation();  // 要求线程层级值大于锁的层级值
+    lock_internal();                  // 内部锁被锁住
+    update_hierarchy_value();         // 更新层级值
+    on_acquired();
+  }
+  void unlock() {
+#if defined(HIERARCHICAL_MUTEX_PROFILE)
+    stats->hold_ns.fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() -
+                                                             acquired)
+            .count(),
+        std::memory_order_relaxed);
+    auto it = std::find(held.rbegin(), held.rend(), this);
+    if (it != held.rend()) held.erase(std::next(it).base());
+    if (this_thread_hierarchy_value != hierarchy_value) {
+      hierarchical_mutex_profile::registry::get().add_violation();
+    }
+#else
+    if (this_thread_hierarchy_value != hierarchy_value) {
+      throw std::logic_error("mutex hierarchy violated");
+    }
+#endif
+    // 恢复前一线程的层级值
+    this_thread_hierarchy_value = previous_hierarchy_value;
+    internal_mutex.unlock();
+  }
+  bool try_lock() {
+    check_for_hierarchy_violation();
+    if (!internal_mutex.try_lock()) return false;
+    update_hierarchy_value();
+    on_acquired();
+    return true;
+  }
+};
+
+#endif
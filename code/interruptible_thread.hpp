@@ -0,0 +1,113 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+// 书中的 interrupt_flag 换成 C++20 的 std::stop_token：请求中断的一方调用
+// stop_source::request_stop，被中断的线程在 interruption_point 或
+// interruptible_wait 中检查。每个线程有一个当前的 stop_token，
+// interruptible_thread 在线程开始时设置它，task_group 在执行任务时设置它
+
+class thread_interrupted : public std::exception {
+ public:
+  const char* what() const noexcept override { return "thread interrupted"; }
+};
+
+inline thread_local std::stop_token this_thread_stop_token;
+
+// 在作用域内把当前线程的 stop_token 换成 token，结束时恢复
+class stop_token_scope {
+  std::stop_token saved;
+
+ public:
+  explicit stop_token_scope(std::stop_token token)
+      : saved(std::exchange(this_thread_stop_token, std::move(token))) {}
+  stop_token_scope(const stop_token_scope&) = delete;
+  stop_token_scope& operator=(const stop_token_scope&) = delete;
+  ~stop_token_scope() { this_thread_stop_token = std::move(saved); }
+};
+
+inline void interruption_point() {
+  if (this_thread_stop_token.stop_requested()) throw thread_interrupted();
+}
+
+// condition_variable_any 本身支持 stop_token，request_stop 会唤醒等待的线程
+template <typename Lockable, typename Predicate>
+void interruptible_wait(std::condition_variable_any& cv, Lockable& l,
+                        Predicate pred) {
+  if (!cv.wait(l, this_thread_stop_token, std::move(pred))) {
+    throw thread_interrupted();
+  }
+}
+
+// std::condition_variable 没有这样的重载，书中每 1ms 醒来检查一次标志。
+// 这里注册 stop_callback，回调持有锁时 notify_all，而等待的线程持有锁时
+// 检查 stop_requested 后才进入等待，因此不会错过通知，中断后立即醒来。
+// 回调可能在注册时就在本线程执行，也可能在其他线程中等待这个锁，
+// 所以注册和注销回调时都不能持有锁
+template <typename Predicate>
+void interruptible_wait(std::condition_variable& cv,
+                        std::unique_lock<std::mutex>& l, Predicate pred) {
+  const std::stop_token token = this_thread_stop_token;
+  if (!token.stop_possible()) {
+    cv.wait(l, pred);
+    return;
+  }
+  struct lock_on_exit {
+    std::unique_lock<std::mutex>& l;
+    ~lock_on_exit() { l.lock(); }
+  };
+  struct unlock_on_exit {
+    std::unique_lock<std::mutex>& l;
+    ~unlock_on_exit() { l.unlock(); }
+  };
+  std::mutex& m = *l.mutex();
+  while (!pred()) {
+    if (token.stop_requested()) throw thread_interrupted();
+    l.unlock();
+    lock_on_exit relock{l};
+    std::stop_callback cb(token, [&] {
+      std::lock_guard<std::mutex> g(m);
+      cv.notify_all();
+    });
+    l.lock();
+    unlock_on_exit unlock{l};
+    cv.wait(l, [&] { return token.stop_requested() || pred(); });
+  }
+}
+
+// 与书中的实现不同，中断标志由 std::jthread 的 stop_source 提供，
+// 不需要用 promise 取回线程的 interrupt_flag 地址。
+// 线程函数因中断抛出的 thread_interrupted 被忽略，析构时请求中断并 join
+class interruptible_thread {
+  std::jthread t;
+
+ public:
+  interruptible_thread() noexcept = default;
+
+  template <typename F, typename... Args>
+  explicit interruptible_thread(F&& f, Args&&... args)
+      : t(
+            [](std::stop_token token, std::decay_t<F> f,
+               std::decay_t<Args>... args) {
+              this_thread_stop_token = std::move(token);
+              try {
+                std::invoke(std::move(f), std::move(args)...);
+              } catch (const thread_interrupted&) {
+              }
+            },
+            std::forward<F>(f), std::forward<Args>(args)...) {}
+
+  void interrupt() noexcept { t.request_stop(); }
+  std::stop_source get_stop_source() noexcept { return t.get_stop_source(); }
+  std::thread::id get_id() const noexcept { return t.get_id(); }
+  bool joinable() const noexcept { return t.joinable(); }
+  void join() { t.join(); }
+  void detach() { t.detach(); }
+};
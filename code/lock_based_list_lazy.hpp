@@ -0,0 +1,124 @@
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>  // for std::as_const
+
+#include "epoch_based_reclamation.hpp"
+
+// 惰性同步（lazy synchronization）的链表：遍历不加锁，
+// 修改时只锁住被修改位置前后的两个节点，加锁后验证两者仍相邻且未被删除。
+// 删除先设置节点的删除标记（逻辑删除）再摘除（物理删除），
+// 遍历时跳过已标记的节点，摘除的节点由 epoch_domain 延迟释放。
+// 节点内直接存储 T，锁只占一个字节。
+// 元素插入后不可修改，因此 for_each 传入 const T&
+template <typename T>
+class thread_safe_list {
+  class spinlock {
+    std::atomic<bool> flag{false};
+
+   public:
+    void lock() {
+      while (flag.exchange(true, std::memory_order_acquire)) {
+        while (flag.load(std::memory_order_relaxed)) std::this_thread::yield();
+      }
+    }
+    bool try_lock() {
+      return !flag.load(std::memory_order_relaxed) &&
+             !flag.exchange(true, std::memory_order_acquire);
+    }
+    void unlock() { flag.store(false, std::memory_order_release); }
+  };
+
+  struct node;
+
+  struct link {  // 头节点只需要链接部分，不存储 T，因此不要求 T 可默认构造
+    std::atomic<node*> next{nullptr};
+    std::atomic<bool> marked{false};  // 已逻辑删除
+    spinlock m;
+  };
+
+  struct node : link {
+    T data;
+    explicit node(const T& x) : data(x) {}
+  };
+
+  link head;
+  epoch_domain domain;
+
+ public:
+  thread_safe_list() {}
+  ~thread_safe_list() {  // 已摘除的节点由 domain 析构时释放
+    node* n = head.next.load();
+    while (n) {
+      node* next = n->next.load();
+      delete n;
+      n = next;
+    }
+  }
+  thread_safe_list(const thread_safe_list&) = delete;
+  thread_safe_list& operator=(const thread_safe_list&) = delete;
+
+  void push_front(const T& x) {
+    node* n = new node(x);
+    std::lock_guard<spinlock> l(head.m);  // 头节点不会被删除，无需验证
+    n->next.store(head.next.load(std::memory_order_relaxed),
+                  std::memory_order_relaxed);
+    head.next.store(n, std::memory_order_release);
+  }
+
+  template <typename F>
+  void for_each(F f) {  // 不加锁，与修改并发时可能看不到刚插入或删除的元素
+    epoch_guard g(domain);
+    for (node* n = head.next.load(std::memory_order_acquire); n;
+         n = n->next.load(std::memory_order_acquire)) {
+      if (!n->marked.load(std::memory_order_acquire)) f(std::as_const(n->data));
+    }
+  }
+
+  template <typename F>
+  std::shared_ptr<T> find_first_if(F f) {  // 返回找到的元素的拷贝
+    epoch_guard g(domain);
+    for (node* n = head.next.load(std::memory_order_acquire); n;
+         n = n->next.load(std::memory_order_acquire)) {
+      if (!n->marked.load(std::memory_order_acquire) &&
+          f(std::as_const(n->data))) {
+        return std::make_shared<T>(n->data);
+      }
+    }
+    return std::shared_ptr<T>();
+  }
+
+  // 每个元素一般只调用一次 f。验证失败时从 pred 继续，pred 已被其他线程删除时
+  // 才从头开始，这时之前已经判断过的元素会再次调用 f
+  template <typename F>
+  void remove_if(F f) {
+    epoch_guard g(domain);
+    link* pred = &head;
+    node* curr = head.next.load(std::memory_order_acquire);
+    node* matched = nullptr;  // 已判定要删除但验证失败的节点，不再调用 f
+    while (curr) {
+      if (curr->marked.load(std::memory_order_acquire) ||
+          (curr != matched && !f(std::as_const(curr->data)))) {
+        pred = curr;
+        curr = curr->next.load(std::memory_order_acquire);
+        continue;
+      }
+      std::scoped_lock l(pred->m, curr->m);
+      // 验证：pred 和 curr 都未被删除且仍然相邻
+      if (pred->marked.load(std::memory_order_relaxed) ||
+          curr->marked.load(std::memory_order_relaxed) ||
+          pred->next.load(std::memory_order_relaxed) != curr) {
+        matched = curr;
+        if (pred->marked.load(std::memory_order_relaxed)) pred = &head;
+        curr = pred->next.load(std::memory_order_acquire);
+        continue;
+      }
+      curr->marked.store(true, std::memory_order_release);
+      node* next = curr->next.load(std::memory_order_relaxed);
+      pred->next.store(next, std::memory_order_release);
+      domain.retire(curr);
+      curr = next;
+    }
+  }
+};
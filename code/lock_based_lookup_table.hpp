@@ -1,32 +1,84 @@
-#include <algorithm>   // for std::find_if
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>  // for std::find_if
+#include <array>
+#include <atomic>
+#include <bit>  // for std::bit_cast
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>  // for std::rename
+#include <cstring>  // for std::memcpy
 #include <functional>  // for std::hash
+#include <future>
 #include <list>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
 #include <utility>  // for std::pair
+#include <vector>
+
+#include "threads_guard.hpp"
 
-template <typename K, typename V, typename Hash = std::hash<K>>
+// Hash 和 KeyEqual 都带有 is_transparent 时，可以用其他类型
+// （如 std::string_view）直接查找 std::string 键，不必构造临时的 K。
+// Mutex 为每个桶的读写锁，读多写少且核心较多时可换成
+// distributed_shared_mutex，避免所有读者争抢同一个计数器
+template <typename K, typename V, typename Hash = std::hash<K>,
+          typename KeyEqual = std::equal_to<K>,
+          typename Mutex = std::shared_mutex>
 class thread_safe_lookup_table {
+  // 一致性快照的写时复制状态，由桶的锁保护：写者持有独占锁，
+  // 快照线程持有共享锁，而同一时间只有一个快照线程，因此无需原子类型
+  struct SnapshotState {
+    std::uint64_t epoch = 0;  // 已为哪一次快照保存或读取过本桶
+    std::vector<std::pair<K, V>> preserved;  // 该次快照开始后首次修改前的内容
+
+    template <typename B>
+    void before_write(const B& b, std::uint64_t current) {
+      if (epoch >= current) return;  // 没有进行中的快照，或本桶已处理过
+      preserved.clear();
+      b.for_each_entry(
+          [&](const K& k, const V& v) { preserved.emplace_back(k, v); });
+      epoch = current;
+    }
+  };
+
   class Bucket {
    public:
     std::list<std::pair<K, V>> data;
-    mutable std::shared_mutex m;  // 每个桶都用这个锁保护
+    mutable Mutex m;  // 每个桶都用这个锁保护
+    mutable SnapshotState snap;
 
-    V value_for(const K& k, const V& v) const {  // 如果未找到则返回v
+    template <typename Q>
+    V value_for(const Q& k, const V& v,
+                const KeyEqual& eq) const {  // 如果未找到则返回v
       // 没有修改任何值，异常安全
-      std::shared_lock<std::shared_mutex> l(m);  // 只读锁，可共享
+      std::shared_lock<Mutex> l(m);  // 只读锁，可共享
+      const V* p = find(k, eq);
+      return p ? *p : v;
+    }
+
+    // 以下操作由调用者负责加锁
+    template <typename Q>
+    const V* find(const Q& k, const KeyEqual& eq) const {
       auto it = std::find_if(data.begin(), data.end(),
-                             [&](auto& x) { return x.first == k; });
-      return it == data.end() ? v : it->second;
+                             [&](auto& x) { return eq(x.first, k); });
+      return it == data.end() ? nullptr : &it->second;
     }
 
-    void add_or_update_mapping(const K& k,
-                               const V& v) {  // 找到则修改，未找到则添加
-      std::unique_lock<std::shared_mutex> l(m);  // 写，单独占用
+    void assign(const K& k, const V& v,
+                const KeyEqual& eq) {  // 找到则修改，未找到则添加
       auto it = std::find_if(data.begin(), data.end(),
-                             [&](auto& x) { return x.first == k; });
+                             [&](auto& x) { return eq(x.first, k); });
       if (it == data.end()) {
         data.emplace_back(k, v);  // emplace_back异常安全
       } else {
@@ -34,48 +86,635 @@ class thread_safe_lookup_table {
       }
     }
 
-    void remove_mapping(
-        const K& k) {  // std::list::erase不会抛异常，因此异常安全
-      std::unique_lock<std::shared_mutex> l(m);  // 写，单独占用
+    template <typename Q>
+    void erase(const Q& k, const KeyEqual& eq) {
+      // std::list::erase不会抛异常，因此异常安全
       auto it = std::find_if(data.begin(), data.end(),
-                             [&](auto& x) { return x.first == k; });
+                             [&](auto& x) { return eq(x.first, k); });
       if (it != data.end()) data.erase(it);
     }
+
+    template <typename F>
+    void for_each_entry(F f) const {
+      for (auto& x : data) f(x.first, x.second);
+    }
+  };
+
+  // K 和 V 都可平凡复制时使用的桶：读者不加锁，而是借助版本号（seqlock）
+  // 乐观地拷贝数据，拷贝前后版本号不同（或为奇数，表示正在写）则重试。
+  // 写者仍在 m 的独占锁下修改，修改前后各递增一次版本号
+  struct record {  // 乐观桶中的条目，也是快照文件中条目的格式
+    K key;
+    V value;
   };
 
-  std::vector<std::unique_ptr<Bucket>> buckets;
+  class OptimisticBucket {
+    using entry = record;
+    // 存储条目的数组，扩容后旧数组保留到桶析构，读者总能安全访问
+    struct block {
+      std::size_t capacity;
+      std::allocator<entry> alloc;
+      entry* entries;
+      bool owned = true;  // 为 false 时 entries 指向快照文件的映射，只读
+      std::unique_ptr<block> prev;
+      explicit block(std::size_t n) : capacity(n), entries(alloc.allocate(n)) {}
+      block(const entry* p, std::size_t n)
+          : capacity(n), entries(const_cast<entry*>(p)), owned(false) {}
+      ~block() {
+        if (owned) alloc.deallocate(entries, capacity);
+      }
+    };
+
+    std::atomic<unsigned> version{0};
+    std::atomic<block*> cur{nullptr};
+    std::atomic<std::size_t> size{0};
+    std::unique_ptr<block> blocks;  // 拥有当前和所有旧的数组
+
+    template <typename T>
+    static T racy_load(const T& x) {
+      // 读取可能正被写者修改的数据，结果只在版本号未变时使用
+      std::array<unsigned char, sizeof(T)> buf;
+      std::memcpy(buf.data(), &x, sizeof(T));
+      return std::bit_cast<T>(buf);
+    }
+
+    template <typename Q>
+    std::size_t index_of(const Q& k, const KeyEqual& eq) const {  // 持有锁
+      const std::size_t n = size.load(std::memory_order_relaxed);
+      const block* b = cur.load(std::memory_order_relaxed);
+      for (std::size_t i = 0; i < n; ++i) {
+        if (eq(b->entries[i].key, k)) return i;
+      }
+      return n;
+    }
+
+    void begin_write() {
+      version.store(version.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void end_write() {
+      version.store(version.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_release);
+    }
+
+    block* reallocate(std::size_t capacity) {  // 换成新数组，内容不变
+      const block* b = cur.load(std::memory_order_relaxed);
+      std::unique_ptr<block> nb(new block(capacity));
+      if (b) {
+        std::uninitialized_copy_n(
+            b->entries, size.load(std::memory_order_relaxed), nb->entries);
+      }
+      nb->prev = std::move(blocks);
+      blocks = std::move(nb);
+      cur.store(blocks.get(), std::memory_order_release);
+      return blocks.get();
+    }
+
+   public:
+    mutable Mutex m;  // 只有写者和需要遍历的操作使用
+    mutable SnapshotState snap;
+
+    template <typename Q>
+    V value_for(const Q& k, const V& v,
+                const KeyEqual& eq) const {  // 如果未找到则返回v
+      for (;;) {
+        const unsigned ver = version.load(std::memory_order_acquire);
+        if (ver & 1) {
+          std::this_thread::yield();
+          continue;
+        }
+        const block* b = cur.load(std::memory_order_acquire);
+        // size 可能比数组新，截断到数组容量，读到的数据由版本号检查兜底
+        const std::size_t n =
+            b ? std::min(size.load(std::memory_order_relaxed), b->capacity)
+              : 0;
+        V res = v;
+        for (std::size_t i = 0; i < n; ++i) {
+          if (eq(racy_load(b->entries[i].key), k)) {
+            res = racy_load(b->entries[i].value);
+            break;
+          }
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (version.load(std::memory_order_relaxed) == ver) return res;
+      }
+    }
+
+    // 以下操作由调用者负责加锁
+    template <typename Q>
+    const V* find(const Q& k, const KeyEqual& eq) const {
+      const std::size_t i = index_of(k, eq);
+      if (i == size.load(std::memory_order_relaxed)) return nullptr;
+      return &cur.load(std::memory_order_relaxed)->entries[i].value;
+    }
+
+    void assign(const K& k, const V& v, const KeyEqual& eq) {
+      const std::size_t n = size.load(std::memory_order_relaxed);
+      const std::size_t i = index_of(k, eq);
+      block* b = cur.load(std::memory_order_relaxed);
+      if (b && !b->owned) {  // 首次写入映射的数据时复制到自己的数组
+        b = reallocate(std::max<std::size_t>(4, 2 * n));
+      } else if (i == n && (!b || n == b->capacity)) {  // 数组已满，扩容两倍
+        b = reallocate(b ? 2 * b->capacity : 4);
+      }
+      begin_write();
+      if (i == n) {
+        ::new (static_cast<void*>(b->entries + n)) entry{k, v};
+        size.store(n + 1, std::memory_order_relaxed);
+      } else {
+        b->entries[i].value = v;
+      }
+      end_write();
+    }
+
+    template <typename Q>
+    void erase(const Q& k, const KeyEqual& eq) {
+      const std::size_t n = size.load(std::memory_order_relaxed);
+      const std::size_t i = index_of(k, eq);
+      if (i == n) return;
+      block* b = cur.load(std::memory_order_relaxed);
+      if (!b->owned) b = reallocate(n);
+      begin_write();
+      b->entries[i] = b->entries[n - 1];  // 用最后一个条目填补空位
+      size.store(n - 1, std::memory_order_relaxed);
+      end_write();
+    }
+
+    template <typename F>
+    void for_each_entry(F f) const {
+      const std::size_t n = size.load(std::memory_order_relaxed);
+      const block* b = cur.load(std::memory_order_relaxed);
+      for (std::size_t i = 0; i < n; ++i) {
+        f(b->entries[i].key, b->entries[i].value);
+      }
+    }
+
+    bool empty() const { return size.load(std::memory_order_relaxed) == 0; }
+
+    // 空桶直接使用快照文件映射中的 n 个条目，不复制，首次写入时才复制
+    void attach(const entry* p, std::size_t n) {
+      std::unique_ptr<block> nb(new block(p, n));
+      nb->prev = std::move(blocks);
+      blocks = std::move(nb);
+      begin_write();
+      cur.store(blocks.get(), std::memory_order_relaxed);
+      size.store(n, std::memory_order_relaxed);
+      end_write();
+    }
+  };
+
+  // 可平凡复制的键值用乐观读，其他类型读者仍使用共享锁
+  using bucket_type =
+      std::conditional_t<std::is_trivially_copyable_v<K> &&
+                             std::is_trivially_copyable_v<V>,
+                         OptimisticBucket, Bucket>;
+
+  static constexpr bool optimistic =
+      std::is_same_v<bucket_type, OptimisticBucket>;
+  static constexpr bool transparent = requires {
+    typename Hash::is_transparent;
+    typename KeyEqual::is_transparent;
+  };
+
+  // 不支持异构查找时，用 Q 类型的键查找需要先构造 K
+  template <typename Q>
+  static constexpr bool needs_conversion =
+      !std::is_same_v<Q, K> && !transparent;
+
+  template <typename Q>
+  static decltype(auto) lookup_key(const Q& k) {
+    if constexpr (!needs_conversion<Q>) {
+      return (k);
+    } else {
+      return K(k);  // 不支持异构查找时只能构造 K
+    }
+  }
+
+  // 快照文件：文件头，bucket_count + 1 个条目下标（第 i 个桶的条目为
+  // [offsets[i], offsets[i + 1])），补齐到 64 字节后是按桶排列的 record 数组
+  struct snapshot_header {
+    char magic[8];
+    std::uint64_t bucket_count;
+    std::uint64_t key_size;
+    std::uint64_t value_size;
+    std::uint64_t record_size;
+    std::uint64_t count;  // 条目总数
+  };
+  static constexpr char snapshot_magic[8] = {'T', 'S', 'L', 'T',
+                                             'S', 'N', 'P', '1'};
+
+  static std::size_t snapshot_data_offset(std::uint64_t bucket_count) {
+    const std::size_t n =
+        sizeof(snapshot_header) + (bucket_count + 1) * sizeof(std::uint64_t);
+    return (n + 63) / 64 * 64;
+  }
+
+  struct file_descriptor {  // 析构时关闭文件
+    int fd;
+    explicit file_descriptor(int x) : fd(x) {
+      if (fd < 0) throw std::system_error(errno, std::generic_category());
+    }
+    file_descriptor(const file_descriptor&) = delete;
+    file_descriptor& operator=(const file_descriptor&) = delete;
+    ~file_descriptor() { ::close(fd); }
+  };
+
+  struct remove_on_failure {  // 析构时删除文件，除非已设置 done
+    const std::string& path;
+    bool done = false;
+    explicit remove_on_failure(const std::string& p) : path(p) {}
+    remove_on_failure(const remove_on_failure&) = delete;
+    remove_on_failure& operator=(const remove_on_failure&) = delete;
+    ~remove_on_failure() {
+      if (!done) ::unlink(path.c_str());
+    }
+  };
+
+  static void write_all(int fd, const void* p, std::size_t n, off_t pos) {
+    const char* s = static_cast<const char*>(p);
+    while (n) {
+      const ssize_t r = ::pwrite(fd, s, n, pos);
+      if (r < 0) {
+        if (errno == EINTR) continue;
+        throw std::system_error(errno, std::generic_category(), "pwrite");
+      }
+      s += r;
+      n -= r;
+      pos += r;
+    }
+  }
+
+  // 用 n 个线程（含当前线程）分别执行 f(0) ~ f(n - 1)，传播其中的异常
+  template <typename F>
+  static void run_parallel(unsigned n, F f) {
+    std::vector<std::future<void>> futures(n - 1);
+    std::vector<std::thread> threads(n - 1);
+    {
+      threads_guard g(threads);
+      for (unsigned i = 0; i + 1 < n; ++i) {
+        std::packaged_task<void()> task([&f, i] { f(i); });
+        futures[i] = task.get_future();
+        threads[i] = std::thread(std::move(task));
+      }
+      f(n - 1);
+    }
+    for (auto& x : futures) x.get();
+  }
+
+  unsigned snapshot_workers(std::size_t bucket_count) const {
+    const unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+    return static_cast<unsigned>(
+        std::max<std::size_t>(1, std::min<std::size_t>(hw, bucket_count)));
+  }
+
+  // 映射到内存的快照文件，在所有桶之后析构
+  std::vector<std::shared_ptr<void>> mappings;  // 由 snapshot_mutex 保护
+  std::vector<std::unique_ptr<bucket_type>> buckets;
   Hash hasher;
-  Bucket& get_bucket(const K& k) const {  // 桶数固定因此可以无锁调用
-    return *buckets[hasher(k) % buckets.size()];
+  KeyEqual eq;
+  // 最近一次一致性快照的编号，写者在桶锁内读取它来决定是否先保存旧内容
+  mutable std::atomic<std::uint64_t> snapshot_epoch{0};
+  mutable std::mutex snapshot_mutex;  // 同一时间只进行一次一致性快照
+  template <typename Q>
+  std::size_t bucket_index(const Q& k) const {  // 桶数固定因此可以无锁调用
+    return hasher(k) % buckets.size();
+  }
+  template <typename Q>
+  bucket_type& get_bucket(const Q& k) const {
+    return *buckets[bucket_index(k)];
+  }
+
+  template <typename Q>
+  void remove(const Q& k) {
+    bucket_type& b = get_bucket(k);
+    std::unique_lock<Mutex> l(b.m);  // 写，单独占用
+    b.snap.before_write(b, snapshot_epoch.load());
+    b.erase(k, eq);
+  }
+
+  // 在桶的共享锁下对第 e 次一致性快照中该桶的内容调用 f(k, v)，
+  // 持有 snapshot_mutex 的线程可以并行处理不同的桶
+  template <typename F>
+  void snapshot_bucket(const bucket_type& b, std::uint64_t e, F f) const {
+    std::shared_lock<Mutex> l(b.m);
+    if (b.snap.epoch == e) {  // 写者已保存修改前的内容
+      for (auto& x : b.snap.preserved) f(x.first, x.second);
+      b.snap.preserved.clear();
+    } else {
+      b.for_each_entry(f);
+      b.snap.epoch = e;  // 之后的写者无需再保存
+    }
+  }
+
+  template <typename Q, typename F>
+  bool visit_impl(const Q& k, F& f) const {
+    const bucket_type& b = get_bucket(k);
+    std::shared_lock<Mutex> l(b.m);
+    const V* p = b.find(k, eq);
+    if (!p) return false;
+    f(*p);
+    return true;
   }
 
  public:
   // 桶数默认为 19（一般用 x % 桶数作为 x 的桶索引，桶数为质数可使桶分布均匀）
-  thread_safe_lookup_table(unsigned n = 19, const Hash& h = Hash{})
-      : buckets(n), hasher(h) {
-    for (auto& x : buckets) x.reset(new Bucket);
+  thread_safe_lookup_table(unsigned n = 19, const Hash& h = Hash{},
+                           const KeyEqual& e = KeyEqual{})
+      : buckets(n), hasher(h), eq(e) {
+    for (auto& x : buckets) x.reset(new bucket_type);
   }
   thread_safe_lookup_table(const thread_safe_lookup_table&) = delete;
   thread_safe_lookup_table& operator=(const thread_safe_lookup_table&) = delete;
   V value_for(const K& k, const V& v = V{}) const {
-    return get_bucket(k).value_for(k, v);
+    return get_bucket(k).value_for(k, v, eq);
+  }
+
+  template <typename Q>
+    requires transparent
+  V value_for(const Q& k, const V& v = V{}) const {
+    return get_bucket(k).value_for(k, v, eq);
   }
 
   void add_or_update_mapping(const K& k, const V& v) {
-    get_bucket(k).add_or_update_mapping(k, v);
+    bucket_type& b = get_bucket(k);
+    std::unique_lock<Mutex> l(b.m);  // 写，单独占用
+    b.snap.before_write(b, snapshot_epoch.load());
+    b.assign(k, v, eq);
   }
 
-  void remove_mapping(const K& k) { get_bucket(k).remove_mapping(k); }
-  // 为了方便使用，提供一个到 std::map 的映射
-  std::map<K, V> get_map() const {
-    std::vector<std::unique_lock<std::shared_mutex>> l;
+  void remove_mapping(const K& k) { remove(k); }
+
+  template <typename Q>
+    requires transparent
+  void remove_mapping(const Q& k) {
+    remove(k);
+  }
+
+  // 在桶的共享锁下对找到的值调用 f(const V&)，不拷贝值，返回是否找到。
+  // f 不能修改本表
+  template <typename F>
+  bool visit(const K& k, F f) const {
+    return visit_impl(k, f);
+  }
+
+  template <typename Q, typename F>
+    requires transparent
+  bool visit(const Q& k, F f) const {
+    return visit_impl(k, f);
+  }
+
+  // 批量查找：out[i] 为 keys[i] 对应的值，未找到则为 v。
+  // 键按桶分组，每个桶只加一次锁（可乐观读的桶本就不加锁）
+  template <typename Keys>
+  void multi_get(const Keys& keys, std::vector<V>& out,
+                 const V& v = V{}) const {
+    out.assign(std::size(keys), v);
+    if constexpr (optimistic) {
+      std::size_t i = 0;
+      for (const auto& k : keys) {
+        decltype(auto) x = lookup_key(k);
+        out[i++] = get_bucket(x).value_for(x, v, eq);
+      }
+    } else {
+      using Q = std::remove_cvref_t<decltype(*std::begin(keys))>;
+      const auto first = std::begin(keys);
+      std::vector<K> converted;  // 需要构造 K 时每个键只构造一次
+      if constexpr (needs_conversion<Q>) {
+        converted.assign(first, std::end(keys));
+      }
+      auto key_at = [&](std::size_t i) -> decltype(auto) {
+        if constexpr (needs_conversion<Q>) {
+          return (converted[i]);
+        } else {
+          return (first[i]);
+        }
+      };
+      std::vector<std::pair<std::size_t, std::size_t>> order;  // 桶索引，位置
+      order.reserve(out.size());
+      for (std::size_t i = 0; i < out.size(); ++i) {
+        order.emplace_back(bucket_index(key_at(i)), i);
+      }
+      std::sort(order.begin(), order.end());
+      for (auto it = order.begin(); it != order.end();) {
+        const std::size_t idx = it->first;
+        const bucket_type& b = *buckets[idx];
+        std::shared_lock<Mutex> l(b.m);
+        for (; it != order.end() && it->first == idx; ++it) {
+          if (const V* p = b.find(key_at(it->second), eq)) {
+            out[it->second] = *p;
+          }
+        }
+      }
+    }
+  }
+
+  // 批量添加或修改，元素为 std::pair<Q, V>，同一个桶的键只加一次锁。
+  // 表中存储的键总是 K，Q 不是 K 时（即使支持异构查找）每个键先构造一次 K
+  template <typename Pairs>
+  void multi_put(const Pairs& kvs) {
+    using Q = std::remove_cvref_t<decltype(std::begin(kvs)->first)>;
+    constexpr bool convert = !std::is_same_v<Q, K>;
+    const auto first = std::begin(kvs);
+    std::vector<K> converted;
+    if constexpr (convert) {
+      converted.reserve(std::size(kvs));
+      for (const auto& x : kvs) converted.emplace_back(x.first);
+    }
+    auto key_at = [&](std::size_t i) -> decltype(auto) {
+      if constexpr (convert) {
+        return (converted[i]);
+      } else {
+        return (first[i].first);
+      }
+    };
+    std::vector<std::pair<std::size_t, std::size_t>> order;  // 桶索引，位置
+    order.reserve(std::size(kvs));
+    for (std::size_t i = 0; i < std::size(kvs); ++i) {
+      order.emplace_back(bucket_index(key_at(i)), i);
+    }
+    std::sort(order.begin(), order.end());
+    for (auto it = order.begin(); it != order.end();) {
+      const std::size_t idx = it->first;
+      bucket_type& b = *buckets[idx];
+      std::unique_lock<Mutex> l(b.m);
+      b.snap.before_write(b, snapshot_epoch.load());
+      for (; it != order.end() && it->first == idx; ++it) {
+        b.assign(key_at(it->second), first[it->second].second, eq);
+      }
+    }
+  }
+
+  // 弱一致性遍历：每次只以共享模式锁住一个桶并对其中的键值调用 f(k, v)，
+  // 遍历期间其他桶的修改可能可见也可能不可见。f 不能修改本表
+  template <typename F>
+  void for_each(F f) const {
     for (auto& x : buckets) {
-      l.push_back(std::unique_lock<std::shared_mutex>(x->m));
+      std::shared_lock<Mutex> l(x->m);
+      x->for_each_entry(f);
     }
-    std::map<K, V> res;
+  }
+
+  // 一致性快照遍历：看到的是调用时刻的内容。快照开始后，
+  // 写者首次修改尚未遍历到的桶前，先把桶的旧内容保存下来（写时复制），
+  // 遍历到该桶时使用保存的内容。同样每次只持有一个桶的锁，f 调用时不持有锁
+  template <typename F>
+  void for_each_snapshot(F f) const {
+    std::lock_guard<std::mutex> sl(snapshot_mutex);
+    const std::uint64_t e = snapshot_epoch.fetch_add(1) + 1;  // 快照时间点
+    std::vector<std::pair<K, V>> tmp;
     for (auto& x : buckets) {
-      for (auto& y : x->data) res.insert(y);
+      snapshot_bucket(*x, e,
+                      [&](const K& k, const V& v) { tmp.emplace_back(k, v); });
+      for (auto& y : tmp) f(y.first, y.second);
+      tmp.clear();
+    }
+  }
+
+  // 把一致性快照并行写入文件，先写临时文件再改名，不会留下写了一半的快照。
+  // 只支持可平凡复制的 K 和 V，文件按本机的内存布局保存，不能跨平台使用
+  void save_snapshot(const std::string& path) const {
+    static_assert(optimistic, "snapshot requires trivially copyable K and V");
+    std::lock_guard<std::mutex> sl(snapshot_mutex);
+    const std::uint64_t e = snapshot_epoch.fetch_add(1) + 1;
+    const std::size_t nb = buckets.size();
+    const unsigned n = snapshot_workers(nb);
+    // 每个线程负责连续的一段桶，先复制到内存，算出位置后再各自写入文件
+    std::vector<std::vector<record>> parts(n);
+    std::vector<std::uint64_t> offsets(nb + 1);
+    run_parallel(n, [&](unsigned w) {
+      for (std::size_t i = nb * w / n; i < nb * (w + 1) / n; ++i) {
+        snapshot_bucket(*buckets[i], e, [&](const K& k, const V& v) {
+          parts[w].push_back(record{k, v});
+        });
+        offsets[i + 1] = parts[w].size();  // 暂存段内的累计个数
+      }
+    });
+    std::vector<std::uint64_t> part_begin(n + 1);
+    for (unsigned w = 0; w < n; ++w) {
+      for (std::size_t i = nb * w / n; i < nb * (w + 1) / n; ++i) {
+        offsets[i + 1] += part_begin[w];
+      }
+      part_begin[w + 1] = part_begin[w] + parts[w].size();
+    }
+    snapshot_header h{};
+    std::memcpy(h.magic, snapshot_magic, sizeof h.magic);
+    h.bucket_count = nb;
+    h.key_size = sizeof(K);
+    h.value_size = sizeof(V);
+    h.record_size = sizeof(record);
+    h.count = part_begin[n];
+    const std::size_t data = snapshot_data_offset(nb);
+    std::vector<char> head(data);
+    std::memcpy(head.data(), &h, sizeof h);
+    std::memcpy(head.data() + sizeof h, offsets.data(),
+                offsets.size() * sizeof(std::uint64_t));
+
+    const std::string tmp = path + ".tmp";
+    remove_on_failure guard(tmp);  // 出错时不留下写了一半的临时文件
+    {
+      file_descriptor f(
+          ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644));
+      write_all(f.fd, head.data(), head.size(), 0);
+      run_parallel(n, [&](unsigned w) {
+        write_all(f.fd, parts[w].data(), parts[w].size() * sizeof(record),
+                  data + part_begin[w] * sizeof(record));
+        std::vector<record>().swap(parts[w]);
+      });
+      if (::fsync(f.fd) < 0) {
+        throw std::system_error(errno, std::generic_category(), "fsync");
+      }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+      throw std::system_error(errno, std::generic_category(), "rename");
     }
+    guard.done = true;
+  }
+
+  // 从 save_snapshot 写的文件加载，与表中已有的键冲突时以文件为准。
+  // Hash 必须与保存时一致。lazy 为 true 且桶数与文件相同时，空桶直接使用
+  // 映射的页面，读取时才由操作系统按需载入，某个桶首次被写时才复制；
+  // 否则映射文件后由多个线程并行插入
+  void load_snapshot(const std::string& path, bool lazy = true) {
+    static_assert(optimistic, "snapshot requires trivially copyable K and V");
+    std::shared_ptr<void> mapping;
+    std::size_t len = 0;
+    {
+      file_descriptor f(::open(path.c_str(), O_RDONLY));
+      struct stat st;
+      if (::fstat(f.fd, &st) < 0) {
+        throw std::system_error(errno, std::generic_category(), "fstat");
+      }
+      len = static_cast<std::size_t>(st.st_size);
+      if (len < sizeof(snapshot_header)) {
+        throw std::runtime_error("snapshot file is truncated");
+      }
+      void* p = ::mmap(nullptr, len, PROT_READ, MAP_PRIVATE, f.fd, 0);
+      if (p == MAP_FAILED) {
+        throw std::system_error(errno, std::generic_category(), "mmap");
+      }
+      mapping.reset(p, [len](void* x) { ::munmap(x, len); });
+    }
+    const char* base = static_cast<const char*>(mapping.get());
+    snapshot_header h;
+    std::memcpy(&h, base, sizeof h);
+    if (std::memcmp(h.magic, snapshot_magic, sizeof h.magic) != 0 ||
+        h.key_size != sizeof(K) || h.value_size != sizeof(V) ||
+        h.record_size != sizeof(record)) {
+      throw std::runtime_error("snapshot file does not match the table");
+    }
+    const std::uint64_t nb = h.bucket_count;
+    if (nb > len / sizeof(std::uint64_t) ||
+        h.count > len / sizeof(record) ||
+        snapshot_data_offset(nb) + h.count * sizeof(record) > len) {
+      throw std::runtime_error("snapshot file is truncated");
+    }
+    const auto* offsets =
+        reinterpret_cast<const std::uint64_t*>(base + sizeof h);
+    for (std::uint64_t i = 0; i < nb; ++i) {
+      if (offsets[i] > offsets[i + 1]) {
+        throw std::runtime_error("snapshot file is corrupted");
+      }
+    }
+    if (offsets[0] != 0 || offsets[nb] != h.count) {
+      throw std::runtime_error("snapshot file is corrupted");
+    }
+    const auto* records =
+        reinterpret_cast<const record*>(base + snapshot_data_offset(nb));
+
+    std::lock_guard<std::mutex> sl(snapshot_mutex);
+    const bool attach = lazy && nb == buckets.size();
+    if (attach) mappings.push_back(mapping);
+    const unsigned n = snapshot_workers(nb);
+    run_parallel(n, [&](unsigned w) {
+      for (std::size_t i = nb * w / n; i < nb * (w + 1) / n; ++i) {
+        const record* first = records + offsets[i];
+        const std::size_t count = offsets[i + 1] - offsets[i];
+        if (!attach) {
+          for (std::size_t j = 0; j < count; ++j) {
+            add_or_update_mapping(first[j].key, first[j].value);
+          }
+          continue;
+        }
+        bucket_type& b = *buckets[i];
+        std::unique_lock<Mutex> l(b.m);
+        b.snap.before_write(b, snapshot_epoch.load());
+        if (b.empty()) {
+          b.attach(first, count);
+        } else {
+          for (std::size_t j = 0; j < count; ++j) {
+            b.assign(first[j].key, first[j].value, eq);
+          }
+        }
+      }
+    });
+  }
+
+  // 为了方便使用，提供一个到 std::map 的映射，内容为一致性快照
+  std::map<K, V> get_map() const {
+    std::map<K, V> res;
+    for_each_snapshot([&](const K& k, const V& v) { res.emplace(k, v); });
     return res;
   }
 };
\ No newline at end of file
@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <functional>  // for std::hash
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>  // for std::pair
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// 开放寻址的查找表：键按哈希分到固定数量的段，每段一把锁，
+// 段内是按 16 个槽位分组的扁平数组，用控制字节（哈希值的高 7 位）做 SIMD 匹配。
+// 段的数量与表的大小无关，扩容只在段内进行，只阻塞访问该段的线程
+template <typename K, typename V, typename Hash = std::hash<K>>
+class thread_safe_lookup_table {
+  static constexpr std::size_t group_size = 16;
+  static constexpr std::uint8_t empty = 0x80;    // 空槽
+  static constexpr std::uint8_t deleted = 0xFE;  // 已删除的槽
+  // 已占用槽位的控制字节为哈希值的高 7 位，即 0x00 ~ 0x7F
+
+  static unsigned match(const std::uint8_t* ctrl, std::uint8_t x) {
+    // 返回一组控制字节中等于 x 的位掩码
+#if defined(__SSE2__)
+    const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+    return static_cast<unsigned>(_mm_movemask_epi8(
+        _mm_cmpeq_epi8(c, _mm_set1_epi8(static_cast<char>(x)))));
+#else
+    unsigned res = 0;
+    for (std::size_t i = 0; i < group_size; ++i) {
+      res |= static_cast<unsigned>(ctrl[i] == x) << i;
+    }
+    return res;
+#endif
+  }
+
+  class Segment {
+    using value_type = std::pair<K, V>;
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    std::allocator<value_type> alloc;
+    std::unique_ptr<std::uint8_t[]> ctrl;
+    value_type* slots = nullptr;
+    std::size_t groups = 0;  // 组数，总为 2 的幂
+    std::size_t size = 0;
+    std::size_t tombstones = 0;
+
+    std::size_t capacity() const { return groups * group_size; }
+
+    // 三角数探测，组数为 2 的幂时可以遍历所有组
+    std::size_t find(std::uint64_t h, const K& k) const {
+      const std::uint8_t tag = static_cast<std::uint8_t>(h >> 57);
+      std::size_t g = h & (groups - 1);
+      for (std::size_t step = 0; step < groups;) {
+        const std::uint8_t* c = &ctrl[g * group_size];
+        for (unsigned bits = match(c, tag); bits; bits &= bits - 1) {
+          const std::size_t i = g * group_size + std::countr_zero(bits);
+          if (slots[i].first == k) return i;
+        }
+        if (match(c, empty)) return npos;  // 有空槽说明探测链到此为止
+        g = (g + ++step) & (groups - 1);
+      }
+      return npos;
+    }
+
+    std::size_t find_free(std::uint64_t h) const {
+      std::size_t g = h & (groups - 1);
+      for (std::size_t step = 0;; g = (g + ++step) & (groups - 1)) {
+        const std::uint8_t* c = &ctrl[g * group_size];
+        if (unsigned bits = match(c, empty) | match(c, deleted)) {
+          return g * group_size + std::countr_zero(bits);
+        }
+      }
+    }
+
+    void rehash(std::size_t new_groups, const Hash& hasher) {
+      Segment s;
+      s.ctrl.reset(new std::uint8_t[new_groups * group_size]);
+      std::fill_n(s.ctrl.get(), new_groups * group_size, empty);
+      s.slots = s.alloc.allocate(new_groups * group_size);
+      s.groups = new_groups;
+      // 移动构造可能抛异常时改为拷贝，失败时 s 析构，原表不变
+      for (std::size_t i = 0; i < capacity(); ++i) {
+        if (ctrl[i] & 0x80) continue;
+        const std::uint64_t h = mix(hasher(slots[i].first));
+        const std::size_t j = s.find_free(h);
+        ::new (static_cast<void*>(s.slots + j))
+            value_type(std::move_if_noexcept(slots[i]));
+        s.ctrl[j] = ctrl[i];
+        ++s.size;
+      }
+      swap(s);
+    }
+
+    void swap(Segment& rhs) noexcept {
+      std::swap(ctrl, rhs.ctrl);
+      std::swap(slots, rhs.slots);
+      std::swap(groups, rhs.groups);
+      std::swap(size, rhs.size);
+      std::swap(tombstones, rhs.tombstones);
+    }
+
+   public:
+    mutable std::shared_mutex m;  // 每个段都用这个锁保护
+
+    Segment() = default;
+    Segment(const Segment&) = delete;
+    Segment& operator=(const Segment&) = delete;
+    ~Segment() {
+      for (std::size_t i = 0; i < capacity(); ++i) {
+        if (!(ctrl[i] & 0x80)) slots[i].~value_type();
+      }
+      if (slots) alloc.deallocate(slots, capacity());
+    }
+
+    V value_for(std::uint64_t h, const K& k, const V& v) const {
+      std::shared_lock<std::shared_mutex> l(m);
+      if (!groups) return v;
+      const std::size_t i = find(h, k);
+      return i == npos ? v : slots[i].second;
+    }
+
+    void add_or_update_mapping(std::uint64_t h, const K& k, const V& v,
+                               const Hash& hasher) {
+      std::unique_lock<std::shared_mutex> l(m);
+      if (groups) {
+        const std::size_t i = find(h, k);
+        if (i != npos) {
+          slots[i].second = v;
+          return;
+        }
+      }
+      // 负载（含已删除的槽）超过 7/8 时重建，已删除的槽较多时不扩容
+      if ((size + tombstones + 1) * 8 > capacity() * 7) {
+        rehash(!groups ? 1 : size * 2 >= capacity() ? groups * 2 : groups,
+               hasher);
+      }
+      const std::size_t i = find_free(h);
+      ::new (static_cast<void*>(slots + i)) value_type(k, v);
+      if (ctrl[i] == deleted) --tombstones;
+      ctrl[i] = static_cast<std::uint8_t>(h >> 57);
+      ++size;
+    }
+
+    void remove_mapping(std::uint64_t h, const K& k) {
+      std::unique_lock<std::shared_mutex> l(m);
+      if (!groups) return;
+      const std::size_t i = find(h, k);
+      if (i == npos) return;
+      slots[i].~value_type();
+      // 所在组原本就有空槽，说明没有探测链经过这个组，可以直接置为空
+      if (match(&ctrl[i / group_size * group_size], empty)) {
+        ctrl[i] = empty;
+      } else {
+        ctrl[i] = deleted;
+        ++tombstones;
+      }
+      --size;
+    }
+
+    template <typename F>
+    void for_each(F f) const {  // 调用者负责加锁
+      for (std::size_t i = 0; i < capacity(); ++i) {
+        if (!(ctrl[i] & 0x80)) f(slots[i]);
+      }
+    }
+  };
+
+  static std::uint64_t mix(std::uint64_t h) {
+    // std::hash 对整数通常是恒等映射，打散后高位和低位才都可用
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  std::vector<std::unique_ptr<Segment>> segments;
+  Hash hasher;
+  Segment& get_segment(std::uint64_t h) const {  // 段数固定因此可以无锁调用
+    return *segments[(h >> 32) % segments.size()];
+  }
+
+ public:
+  // n 为段（锁）的数量，与表中元素的多少无关
+  thread_safe_lookup_table(unsigned n = 64, const Hash& h = Hash{})
+      : segments(n), hasher(h) {
+    for (auto& x : segments) x.reset(new Segment);
+  }
+  thread_safe_lookup_table(const thread_safe_lookup_table&) = delete;
+  thread_safe_lookup_table& operator=(const thread_safe_lookup_table&) = delete;
+  V value_for(const K& k, const V& v = V{}) const {
+    const std::uint64_t h = mix(hasher(k));
+    return get_segment(h).value_for(h, k, v);
+  }
+
+  void add_or_update_mapping(const K& k, const V& v) {
+    const std::uint64_t h = mix(hasher(k));
+    get_segment(h).add_or_update_mapping(h, k, v, hasher);
+  }
+
+  void remove_mapping(const K& k) {
+    const std::uint64_t h = mix(hasher(k));
+    get_segment(h).remove_mapping(h, k);
+  }
+
+  std::map<K, V> get_map() const {
+    std::vector<std::shared_lock<std::shared_mutex>> l;
+    for (auto& x : segments) {
+      l.push_back(std::shared_lock<std::shared_mutex>(x->m));
+    }
+    std::map<K, V> res;
+    for (auto& x : segments) {
+      x->for_each([&](auto& y) { res.insert(y); });
+    }
+    return res;
+  }
+};
@@ -1,47 +1,93 @@
+#pragma once
+
 #include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <stop_token>
+#include <type_traits>
 #include <utility>
 
+#include "event_count.hpp"
+
 
-template <typename T>
+// Mutex 可以换成 spin_locks.hpp 中的锁，此时使用 std::condition_variable_any
+template <typename T, typename Mutex = std::mutex>
 class thread_safe_queue {
-  mutable std::mutex m;
+  mutable Mutex m;
   std::queue<std::shared_ptr<T>> q;
-  std::condition_variable cv;
+  std::conditional_t<std::is_same_v<Mutex, std::mutex>,
+                     std::condition_variable, std::condition_variable_any>
+      cv;
+  event_count* notifier = nullptr;  // 等待多个队列的线程共用，由 m 保护
 
  public:
   thread_safe_queue() {}
   thread_safe_queue(const thread_safe_queue& rhs) {
-    std::lock_guard<std::mutex> l(rhs.m);
+    std::lock_guard<Mutex> l(rhs.m);
     q = rhs.q;
   }
 
   void push(T x) {
     std::shared_ptr<T> data(std::make_shared<T>(std::move(x)));
-    std::lock_guard<std::mutex> l(m);
+    std::lock_guard<Mutex> l(m);
     q.push(data);
     cv.notify_one();
+    // 持有锁时通知，set_notifier 返回后不会再有 push 访问原来的 event_count
+    if (notifier) notifier->notify_all();
+  }
+
+  void set_notifier(event_count* ec) {
+    std::lock_guard<Mutex> l(m);
+    notifier = ec;
   }
 
   void wait_and_pop(T& x) {
-    std::unique_lock<std::mutex> l(m);
+    std::unique_lock<Mutex> l(m);
     cv.wait(l, [this] { return !q.empty(); });
     x = std::move(*q.front());
     q.pop();
   }
 
   std::shared_ptr<T> wait_and_pop() {
-    std::unique_lock<std::mutex> l(m);
+    std::unique_lock<Mutex> l(m);
     cv.wait(l, [this] { return !q.empty(); });
     std::shared_ptr<T> res = q.front();
     q.pop();
     return res;
   }
 
+  // 等待到有元素或 token 被请求停止，有元素时优先取出，停止时返回 false。
+  // 回调在注册时可能立即在本线程执行，所以先注册再加锁；
+  // l 先于 cb 析构，注销回调时不持有锁，不会与正在执行的回调死锁
+  bool wait_and_pop(T& x, std::stop_token token) {
+    std::stop_callback cb(token, [this] {
+      std::lock_guard<Mutex> l(m);
+      cv.notify_all();
+    });
+    std::unique_lock<Mutex> l(m);
+    cv.wait(l, [&] { return !q.empty() || token.stop_requested(); });
+    if (q.empty()) return false;
+    x = std::move(*q.front());
+    q.pop();
+    return true;
+  }
+
+  std::shared_ptr<T> wait_and_pop(std::stop_token token) {  // 停止时返回空指针
+    std::stop_callback cb(token, [this] {
+      std::lock_guard<Mutex> l(m);
+      cv.notify_all();
+    });
+    std::unique_lock<Mutex> l(m);
+    cv.wait(l, [&] { return !q.empty() || token.stop_requested(); });
+    if (q.empty()) return std::shared_ptr<T>();
+    std::shared_ptr<T> res = q.front();
+    q.pop();
+    return res;
+  }
+
   bool try_pop(T& x) {
-    std::lock_guard<std::mutex> l(m);
+    std::lock_guard<Mutex> l(m);
     if (q.empty()) return false;
     x = std::move(*q.front());
     q.pop();
@@ -49,7 +95,7 @@ class thread_safe_queue {
   }
 
   std::shared_ptr<T> try_pop() {
-    std::lock_guard<std::mutex> l(m);
+    std::lock_guard<Mutex> l(m);
     if (q.empty()) return std::shared_ptr<T>();
     std::shared_ptr<T> res = q.front();
     q.pop();
@@ -57,7 +103,7 @@ class thread_safe_queue {
   }
 
   bool empty() const {
-    std::lock_guard<std::mutex> l(m);
+    std::lock_guard<Mutex> l(m);
     return q.empty();
   }
 };
\ No newline at end of file
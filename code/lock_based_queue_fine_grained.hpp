@@ -3,6 +3,8 @@
 #include <mutex>
 #include <utility>
 
+#include "event_count.hpp"
+
 template <typename T>
 class thread_safe_queue {
   struct node {
@@ -14,6 +16,7 @@ class thread_safe_queue {
   std::mutex hm;  // head mutex
   std::mutex tm;  // tail mutex
   std::condition_variable cv;
+  event_count* notifier = nullptr;  // 等待多个队列的线程共用，由 tm 保护
 
   node* get_tail() {
     std::lock_guard<std::mutex> l(tm);
@@ -69,10 +72,17 @@ class thread_safe_queue {
       node* const newTail = p.get();
       tail->next = std::move(p);
       tail = newTail;
+      // 持有锁时通知，set_notifier 返回后不会再有 push 访问原来的 event_count
+      if (notifier) notifier->notify_all();
     }
     cv.notify_one();
   }
 
+  void set_notifier(event_count* ec) {
+    std::lock_guard<std::mutex> l(tm);
+    notifier = ec;
+  }
+
   std::shared_ptr<T> wait_and_pop() {
     std::unique_ptr<node> oldHead = wait_pop_head();
     return oldHead->val;
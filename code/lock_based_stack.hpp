@@ -1,6 +1,9 @@
+#pragma once
+
 #include <exception>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <stack>
 #include <utility>
 
@@ -43,6 +46,22 @@ class thread_safe_stack {
     s.pop();
   }
 
+  bool try_pop(T& n) {  // 栈为空时返回 false，不抛异常
+    std::lock_guard<std::mutex> l(m);
+    if (s.empty()) return false;
+    n = std::move(s.top());
+    s.pop();
+    return true;
+  }
+
+  std::optional<T> try_pop() {
+    std::lock_guard<std::mutex> l(m);
+    if (s.empty()) return std::nullopt;
+    std::optional<T> res(std::move(s.top()));
+    s.pop();
+    return res;
+  }
+
   bool empty() const {
     std::lock_guard<std::mutex> l(m);
     return s.empty();
@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>  // for std::bit_width, std::bit_ceil
+#include <cstdint>
+#include <functional>  // for std::hash
+#include <map>
+#include <memory>
+
+#include "epoch_based_reclamation.hpp"
+
+// 无锁的分裂有序表（Shalev 和 Shavit 的 split-ordered list）：
+// 所有元素在一条按哈希值二进制反转排序的无锁链表中，
+// 桶只是指向链表中哨兵节点的指针。桶数翻倍时原有元素的位置不变，
+// 新桶 b 的哨兵在首次访问时插到其父桶（b 去掉最高位的 1）之后，
+// 因此扩容只是把桶数加倍，不搬移元素，也不阻塞任何操作。
+// 值存放在单独分配的对象中，修改时原子地替换指针，旧值与摘除的节点由
+// epoch_domain 延迟释放。接口与 thread_safe_lookup_table 相同
+template <typename K, typename V, typename Hash = std::hash<K>>
+class thread_safe_lookup_table {
+  static constexpr unsigned max_segments = 64;
+  static constexpr std::size_t max_load = 2;  // 平均每个桶的元素数上限
+
+  struct node {
+    const std::uint64_t so_key;  // 反转后的哈希值，元素为奇数，哨兵为偶数
+    std::atomic<std::uintptr_t> next{0};  // 最低位为删除标记
+    explicit node(std::uint64_t x) : so_key(x) {}
+  };
+
+  struct item : node {
+    const K key;
+    std::atomic<V*> value;
+    item(std::uint64_t x, const K& k, V* v) : node(x), key(k), value(v) {}
+    ~item() { delete value.load(std::memory_order_relaxed); }
+  };
+
+  static void destroy(void* p) {
+    node* n = static_cast<node*>(p);
+    if (n->so_key & 1) {
+      delete static_cast<item*>(n);
+    } else {
+      delete n;
+    }
+  }
+
+  static node* ptr(std::uintptr_t x) {
+    return reinterpret_cast<node*>(x & ~std::uintptr_t(1));
+  }
+  static bool marked(std::uintptr_t x) { return x & 1; }
+  static std::uintptr_t make(node* n) {
+    return reinterpret_cast<std::uintptr_t>(n);
+  }
+
+  static std::uint64_t mix(std::uint64_t h) {
+    // std::hash 对整数通常是恒等映射，打散后低位才能均匀分到各个桶
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  static std::uint64_t reverse(std::uint64_t x) {
+    x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+    x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    x = ((x >> 8) & 0x00FF00FF00FF00FFULL) | ((x & 0x00FF00FF00FF00FFULL) << 8);
+    x = ((x >> 16) & 0x0000FFFF0000FFFFULL) |
+        ((x & 0x0000FFFF0000FFFFULL) << 16);
+    return (x >> 32) | (x << 32);
+  }
+
+  static std::uint64_t regular_key(std::uint64_t h) { return reverse(h) | 1; }
+  static std::uint64_t dummy_key(std::size_t b) { return reverse(b); }
+
+  // 桶目录分段按需分配：第 0 段只有桶 0，第 s 段为桶 [2^(s-1), 2^s)，
+  // 已分配的段不会移动，读者无需加锁
+  using segment = std::atomic<node*>;
+  mutable std::atomic<segment*> segments[max_segments] = {};
+  std::atomic<std::size_t> bucket_count;  // 总为 2 的幂
+  std::atomic<std::size_t> count{0};
+  Hash hasher;
+  mutable epoch_domain domain;
+
+  std::atomic<node*>* bucket_slot(std::size_t b, bool create) const {
+    const unsigned s = std::bit_width(b);
+    const std::size_t base = s ? std::size_t(1) << (s - 1) : 0;
+    segment* p = segments[s].load(std::memory_order_acquire);
+    if (!p) {
+      if (!create) return nullptr;
+      segment* np = new segment[s ? base : 1]();
+      if (segments[s].compare_exchange_strong(p, np,
+                                              std::memory_order_acq_rel)) {
+        p = np;
+      } else {
+        delete[] np;
+      }
+    }
+    return &p[b - base];
+  }
+
+  // 在从 start 开始的链表中找第一个不小于 so_key 的节点，沿途摘除并回收
+  // 已标记删除的节点。返回是否找到 so_key 相同的哨兵或键为 k 的元素，
+  // prev 为指向 curr 的链接
+  bool find(node* start, std::uint64_t so_key, const K* k,
+            std::atomic<std::uintptr_t>*& prev, node*& curr) {
+  retry:
+    prev = &start->next;
+    curr = ptr(prev->load(std::memory_order_acquire));
+    while (curr) {
+      const std::uintptr_t next = curr->next.load(std::memory_order_acquire);
+      if (marked(next)) {
+        std::uintptr_t expected = make(curr);
+        if (!prev->compare_exchange_strong(expected, make(ptr(next)),
+                                           std::memory_order_acq_rel)) {
+          goto retry;  // prev 所在节点已被删除或后继已改变
+        }
+        domain.retire(curr, &destroy);  // 摘除成功的线程负责回收
+        curr = ptr(next);
+        continue;
+      }
+      if (curr->so_key > so_key) return false;
+      if (curr->so_key == so_key &&
+          (!k || static_cast<item*>(curr)->key == *k)) {
+        return true;
+      }
+      prev = &curr->next;
+      curr = ptr(next);
+    }
+    return false;
+  }
+
+  node* get_bucket(std::size_t b) {  // 返回桶 b 的哨兵，必要时先初始化
+    std::atomic<node*>* slot = bucket_slot(b, true);
+    if (node* d = slot->load(std::memory_order_acquire)) return d;
+    // 父桶为 b 去掉最高位的 1，新哨兵一定排在父桶的哨兵之后
+    node* parent = get_bucket(b & ~(std::size_t(1) << (std::bit_width(b) - 1)));
+    node* d = new node(dummy_key(b));
+    std::atomic<std::uintptr_t>* prev;
+    node* curr;
+    for (;;) {
+      if (find(parent, d->so_key, nullptr, prev, curr)) {  // 其他线程已插入
+        delete d;
+        d = curr;
+        break;
+      }
+      d->next.store(make(curr), std::memory_order_relaxed);
+      std::uintptr_t expected = make(curr);
+      if (prev->compare_exchange_strong(expected, make(d),
+                                        std::memory_order_acq_rel)) {
+        break;
+      }
+    }
+    slot->store(d, std::memory_order_release);
+    return d;
+  }
+
+  // 只读查找用：桶 b 未初始化时它的元素都还在父桶的范围内
+  node* initialized_bucket(std::size_t b) const {
+    for (;; b &= ~(std::size_t(1) << (std::bit_width(b) - 1))) {
+      if (const std::atomic<node*>* slot = bucket_slot(b, false)) {
+        if (node* d = slot->load(std::memory_order_acquire)) return d;
+      }
+    }
+  }
+
+ public:
+  // n 为初始桶数，向上取整为 2 的幂，之后随元素增多自动翻倍
+  explicit thread_safe_lookup_table(unsigned n = 2, const Hash& h = Hash{})
+      : bucket_count(std::bit_ceil(std::max(2u, n))), hasher(h) {
+    node* d = new node(dummy_key(0));  // 桶 0 的哨兵即链表头
+    bucket_slot(0, true)->store(d, std::memory_order_relaxed);
+  }
+  thread_safe_lookup_table(const thread_safe_lookup_table&) = delete;
+  thread_safe_lookup_table& operator=(const thread_safe_lookup_table&) = delete;
+  ~thread_safe_lookup_table() {  // 已摘除的节点由 domain 析构时释放
+    node* n = bucket_slot(0, false)->load();
+    while (n) {
+      node* next = ptr(n->next.load());
+      destroy(n);
+      n = next;
+    }
+    for (auto& x : segments) delete[] x.load();
+  }
+
+  V value_for(const K& k, const V& v = V{}) const {
+    epoch_guard g(domain);
+    const std::uint64_t h = mix(hasher(k));
+    const std::uint64_t so_key = regular_key(h);
+    const std::size_t b = h & (bucket_count.load() - 1);
+    // 不摘除节点，跳过已标记删除的即可
+    for (node* n = ptr(initialized_bucket(b)->next.load(
+             std::memory_order_acquire));
+         n && n->so_key <= so_key;) {
+      const std::uintptr_t next = n->next.load(std::memory_order_acquire);
+      if (!marked(next) && n->so_key == so_key &&
+          static_cast<item*>(n)->key == k) {
+        return *static_cast<item*>(n)->value.load(std::memory_order_acquire);
+      }
+      n = ptr(next);
+    }
+    return v;
+  }
+
+  void add_or_update_mapping(const K& k, const V& v) {
+    epoch_guard g(domain);
+    const std::uint64_t h = mix(hasher(k));
+    const std::uint64_t so_key = regular_key(h);
+    const std::size_t size = bucket_count.load();
+    node* start = get_bucket(h & (size - 1));
+    std::unique_ptr<V> nv(new V(v));
+    std::unique_ptr<item> n;
+    std::atomic<std::uintptr_t>* prev;
+    node* curr;
+    for (;;) {
+      if (find(start, so_key, &k, prev, curr)) {  // 已存在则替换值
+        V* old = static_cast<item*>(curr)->value.exchange(
+            nv.release(), std::memory_order_acq_rel);
+        domain.retire(old);
+        return;
+      }
+      if (!n) n.reset(new item(so_key, k, nullptr));
+      n->next.store(make(curr), std::memory_order_relaxed);
+      n->value.store(nv.get(), std::memory_order_relaxed);
+      std::uintptr_t expected = make(curr);
+      if (prev->compare_exchange_strong(expected, make(n.get()),
+                                        std::memory_order_acq_rel)) {
+        nv.release();
+        n.release();
+        break;
+      }
+      n->value.store(nullptr, std::memory_order_relaxed);
+    }
+    // 平均负载过高时桶数翻倍，新桶在首次访问时才初始化
+    if (count.fetch_add(1) + 1 > size * max_load &&
+        std::bit_width(size) < max_segments) {
+      std::size_t expected = size;
+      bucket_count.compare_exchange_strong(expected, size * 2);
+    }
+  }
+
+  void remove_mapping(const K& k) {
+    epoch_guard g(domain);
+    const std::uint64_t h = mix(hasher(k));
+    const std::uint64_t so_key = regular_key(h);
+    node* start = get_bucket(h & (bucket_count.load() - 1));
+    std::atomic<std::uintptr_t>* prev;
+    node* curr;
+    for (;;) {
+      if (!find(start, so_key, &k, prev, curr)) return;
+      std::uintptr_t next = curr->next.load(std::memory_order_acquire);
+      if (marked(next)) continue;  // 其他线程正在删除，重新查找
+      // 先标记（逻辑删除），标记成功的线程负责删除
+      if (!curr->next.compare_exchange_strong(next, next | 1,
+                                              std::memory_order_acq_rel)) {
+        continue;
+      }
+      count.fetch_sub(1);
+      std::uintptr_t expected = make(curr);
+      if (prev->compare_exchange_strong(expected, next,
+                                        std::memory_order_acq_rel)) {
+        domain.retire(curr, &destroy);
+      } else {
+        find(start, so_key, &k, prev, curr);  // 由查找摘除
+      }
+      return;
+    }
+  }
+
+  std::map<K, V> get_map() const {  // 弱一致性：遍历期间的修改可能不可见
+    epoch_guard g(domain);
+    std::map<K, V> res;
+    for (node* n = bucket_slot(0, false)->load(); n;) {
+      const std::uintptr_t next = n->next.load(std::memory_order_acquire);
+      if ((n->so_key & 1) && !marked(next)) {
+        const item* x = static_cast<item*>(n);
+        res.emplace(x->key, *x->value.load(std::memory_order_acquire));
+      }
+      n = ptr(next);
+    }
+    return res;
+  }
+};
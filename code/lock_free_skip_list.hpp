@@ -0,0 +1,391 @@
+#include <atomic>
+#include <bit>  // for std::countr_zero
+#include <cstddef>
+#include <cstdint>
+#include <functional>  // for std::less
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "epoch_based_reclamation.hpp"
+
+// 无锁跳表（Herlihy 和 Shavit 的算法），按 Compare 有序的映射，
+// 插入、查找、删除的期望复杂度为 O(log n)，查找不修改任何共享数据。
+// 删除时先在每一层的后继指针上打标记（最低位），再由之后经过的操作摘除。
+// 值在插入后不可修改，要修改可以删除后重新插入，或者让 V 本身是原子类型。
+// 摘除的节点由 epoch_domain 延迟释放
+template <typename K, typename V, typename Compare = std::less<K>>
+class lock_free_skip_list {
+  static constexpr int max_level = 32;
+  using link = std::atomic<std::uintptr_t>;  // 节点指针，最低位为删除标记
+
+  struct alignas(link) node {
+    const K key;
+    const V value;
+    const int height;
+    // 插入者和删除者各持有一份，都完成后才能确定节点已从各层摘除，
+    // 由最后完成的一方摘除并回收
+    std::atomic<int> owners{2};
+
+    node(const K& k, const V& v, int h) : key(k), value(v), height(h) {}
+
+    link* next() { return reinterpret_cast<link*>(this + 1); }  // height 层
+
+    static node* create(const K& k, const V& v, int h) {
+      void* p = ::operator new(sizeof(node) + h * sizeof(link));
+      node* n;
+      try {
+        n = ::new (p) node(k, v, h);
+      } catch (...) {
+        ::operator delete(p);
+        throw;
+      }
+      for (int i = 0; i < h; ++i) {
+        ::new (static_cast<void*>(n->next() + i)) link(0);
+      }
+      return n;
+    }
+
+    static void destroy(void* p) {
+      node* n = static_cast<node*>(p);
+      n->~node();
+      ::operator delete(p);
+    }
+  };
+
+  static node* ptr(std::uintptr_t x) {
+    return reinterpret_cast<node*>(x & ~std::uintptr_t(1));
+  }
+  static bool marked(std::uintptr_t x) { return x & 1; }
+  static std::uintptr_t make(node* n) {
+    return reinterpret_cast<std::uintptr_t>(n);
+  }
+
+  link head[max_level] = {};
+  Compare comp;
+  mutable epoch_domain domain;
+
+  bool equal(const K& a, const K& b) const {
+    return !comp(a, b) && !comp(b, a);
+  }
+
+  static int random_level() {  // 层数为 k 的概率为 1 / 2^k
+    thread_local std::uint64_t x =
+        std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1;
+    x ^= x << 13;  // xorshift64
+    x ^= x >> 7;
+    x ^= x << 17;
+    return 1 + std::countr_zero(x | (std::uint64_t(1) << (max_level - 1)));
+  }
+
+  // 找出每一层中最后一个小于 k 的节点（preds，用其后继数组表示，头节点为 head）
+  // 和其后第一个节点（succs），沿途摘除已标记删除的节点。
+  // 返回第 0 层是否有未删除的键为 k 的节点
+  bool locate(const K& k, link** preds, node** succs) {
+  retry:
+    link* pred = head;
+    for (int lvl = max_level - 1; lvl >= 0; --lvl) {
+      node* curr = ptr(pred[lvl].load(std::memory_order_acquire));
+      while (curr) {
+        std::uintptr_t succ =
+            curr->next()[lvl].load(std::memory_order_acquire);
+        if (marked(succ)) {  // curr 已删除，从这一层摘除
+          std::uintptr_t expected = make(curr);
+          if (!pred[lvl].compare_exchange_strong(expected, make(ptr(succ)),
+                                                 std::memory_order_acq_rel)) {
+            goto retry;  // pred 已被删除或后继已改变
+          }
+          curr = ptr(succ);
+          continue;
+        }
+        if (!comp(curr->key, k)) break;
+        pred = curr->next();
+        curr = ptr(succ);
+      }
+      preds[lvl] = pred;
+      succs[lvl] = curr;
+    }
+    return succs[0] && equal(succs[0]->key, k);
+  }
+
+  // 摘除每一层中键不大于 k 的已删除节点。与 locate 不同，每一层都从头节点
+  // 开始，不会漏掉上一层的 pred 之前的节点，用于一次摘除多个被删除的节点
+  void unlink_prefix(const K& k) {
+    for (int lvl = max_level - 1; lvl >= 0; --lvl) {
+      link* pred = head;
+      node* curr = ptr(pred[lvl].load(std::memory_order_acquire));
+      while (curr) {
+        std::uintptr_t succ =
+            curr->next()[lvl].load(std::memory_order_acquire);
+        if (marked(succ)) {
+          std::uintptr_t expected = make(curr);
+          if (!pred[lvl].compare_exchange_strong(expected, make(ptr(succ)),
+                                                 std::memory_order_acq_rel)) {
+            pred = head;  // pred 已被删除或后继已改变，这一层从头开始
+            curr = ptr(pred[lvl].load(std::memory_order_acquire));
+            continue;
+          }
+          curr = ptr(succ);
+          continue;
+        }
+        if (comp(k, curr->key)) break;
+        pred = curr->next();
+        curr = ptr(succ);
+      }
+    }
+  }
+
+  // 从 n 所在的每一层摘除已标记删除的 n。不能用 locate：它在第一个键不小于
+  // k 的未删除节点处停下，而重新插入的同键节点可能在高层链在 n 之前
+  // （它查找时 n 尚未删除），n 仍可经由它到达。这里每一层先找到最后一个键
+  // 小于 k 的节点，再越过所有键等于 k 的节点直到键大于 k，摘除其中已删除的
+  void unlink(node* n) {
+    const K& k = n->key;
+  retry:
+    link* pred = head;
+    for (int lvl = max_level - 1; lvl >= 0; --lvl) {
+      node* curr = ptr(pred[lvl].load(std::memory_order_acquire));
+      while (curr) {
+        std::uintptr_t succ =
+            curr->next()[lvl].load(std::memory_order_acquire);
+        if (marked(succ)) {
+          std::uintptr_t expected = make(curr);
+          if (!pred[lvl].compare_exchange_strong(expected, make(ptr(succ)),
+                                                 std::memory_order_acq_rel)) {
+            goto retry;
+          }
+          curr = ptr(succ);
+          continue;
+        }
+        if (!comp(curr->key, k)) break;
+        pred = curr->next();
+        curr = ptr(succ);
+      }
+      if (lvl >= n->height) continue;
+      link* p = pred;  // 下一层仍从 pred 开始
+      while (curr && !comp(k, curr->key)) {
+        std::uintptr_t succ =
+            curr->next()[lvl].load(std::memory_order_acquire);
+        if (marked(succ)) {
+          std::uintptr_t expected = make(curr);
+          if (!p[lvl].compare_exchange_strong(expected, make(ptr(succ)),
+                                              std::memory_order_acq_rel)) {
+            goto retry;
+          }
+          curr = ptr(succ);
+          continue;
+        }
+        p = curr->next();
+        curr = ptr(succ);
+      }
+    }
+  }
+
+  // 不修改链表的查找，返回第一个键不小于 k 的未删除节点
+  node* lower_bound(const K& k) const {
+    const link* pred = head;
+    node* curr = nullptr;
+    for (int lvl = max_level - 1; lvl >= 0; --lvl) {
+      curr = ptr(pred[lvl].load(std::memory_order_acquire));
+      while (curr) {
+        const std::uintptr_t succ =
+            curr->next()[lvl].load(std::memory_order_acquire);
+        if (marked(succ)) {  // 跳过已删除的节点
+          curr = ptr(succ);
+        } else if (comp(curr->key, k)) {
+          pred = curr->next();
+          curr = ptr(succ);
+        } else {
+          break;
+        }
+      }
+    }
+    return curr;
+  }
+
+  // 从上往下标记 n 的各层，返回是否由本线程标记了第 0 层（即完成删除）
+  static bool mark(node* n) {
+    for (int i = n->height - 1; i > 0; --i) {
+      std::uintptr_t x = n->next()[i].load(std::memory_order_acquire);
+      while (!marked(x) && !n->next()[i].compare_exchange_weak(
+                               x, x | 1, std::memory_order_acq_rel)) {
+      }
+    }
+    std::uintptr_t x = n->next()[0].load(std::memory_order_acquire);
+    for (;;) {
+      if (marked(x)) return false;
+      if (n->next()[0].compare_exchange_weak(x, x | 1,
+                                             std::memory_order_acq_rel)) {
+        return true;
+      }
+    }
+  }
+
+  void release(node* n) {  // 插入者或删除者完成，最后一方负责回收
+    if (n->owners.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+    unlink(n);  // 插入者已完成，此后没有线程会再把 n 链入任何一层
+    domain.retire(n, &node::destroy);
+  }
+
+ public:
+  explicit lock_free_skip_list(const Compare& c = Compare{}) : comp(c) {}
+  lock_free_skip_list(const lock_free_skip_list&) = delete;
+  lock_free_skip_list& operator=(const lock_free_skip_list&) = delete;
+  ~lock_free_skip_list() {  // 已摘除的节点由 domain 析构时释放
+    node* n = ptr(head[0].load());
+    while (n) {
+      node* next = ptr(n->next()[0].load());
+      node::destroy(n);
+      n = next;
+    }
+  }
+
+  bool insert(const K& k, const V& v) {  // 键已存在则返回 false
+    epoch_guard g(domain);
+    link* preds[max_level];
+    node* succs[max_level];
+    const int h = random_level();
+    node* n = nullptr;
+    for (;;) {
+      if (locate(k, preds, succs)) {
+        if (n) node::destroy(n);  // 未发布，可以直接释放
+        return false;
+      }
+      if (!n) n = node::create(k, v, h);
+      for (int i = 0; i < h; ++i) {
+        n->next()[i].store(make(succs[i]), std::memory_order_relaxed);
+      }
+      std::uintptr_t expected = make(succs[0]);
+      // 链入第 0 层即插入成功，更高的层只是索引
+      if (preds[0][0].compare_exchange_strong(expected, make(n),
+                                              std::memory_order_acq_rel)) {
+        break;
+      }
+    }
+    for (int i = 1; i < h; ++i) {
+      for (;;) {
+        std::uintptr_t expected = make(succs[i]);
+        if (preds[i][i].compare_exchange_strong(expected, make(n),
+                                                std::memory_order_acq_rel)) {
+          break;
+        }
+        locate(k, preds, succs);
+        // 把 n 在这一层的后继改为新的位置，n 已被删除则不再继续链入
+        std::uintptr_t old = n->next()[i].load(std::memory_order_acquire);
+        if (marked(old) ||
+            !n->next()[i].compare_exchange_strong(old, make(succs[i]),
+                                                  std::memory_order_acq_rel)) {
+          release(n);
+          return true;
+        }
+      }
+    }
+    release(n);
+    return true;
+  }
+
+  bool erase(const K& k) {  // 键不存在则返回 false
+    epoch_guard g(domain);
+    link* preds[max_level];
+    node* succs[max_level];
+    if (!locate(k, preds, succs)) return false;
+    node* n = succs[0];
+    if (!mark(n)) return false;  // 被其他线程抢先删除
+    release(n);  // 由最后完成的一方从各层摘除
+    return true;
+  }
+
+  // 删除并取出最小的键值，为空时返回 false
+  bool pop_front(K& k, V& v) {
+    epoch_guard g(domain);
+    for (;;) {
+      node* n = ptr(head[0].load(std::memory_order_acquire));
+      while (n && marked(n->next()[0].load(std::memory_order_acquire))) {
+        n = ptr(n->next()[0].load(std::memory_order_acquire));
+      }
+      if (!n) return false;
+      if (!mark(n)) continue;  // 被其他线程抢先删除，取下一个
+      k = n->key;
+      v = n->value;
+      release(n);
+      return true;
+    }
+  }
+
+  // 删除最小的至多 n 个键值，按顺序对每个调用 f(k, v)，返回删除的个数。
+  // 沿第 0 层扫过一遍并标记这些节点，再沿各层扫过一遍把它们摘除，
+  // 而 n 次 pop_front 需要 2n 次从顶层开始的查找。
+  // 调用 f 时节点已被删除，f 抛出异常时之后的键值不会再交给调用者
+  template <typename F>
+  std::size_t pop_front_n(std::size_t n, F f) {
+    epoch_guard g(domain);
+    std::vector<node*> popped;
+    for (node* curr = ptr(head[0].load(std::memory_order_acquire));
+         curr && popped.size() < n;
+         curr = ptr(curr->next()[0].load(std::memory_order_acquire))) {
+      if (mark(curr)) popped.push_back(curr);
+    }
+    if (popped.empty()) return 0;
+    // 插入者已完成的节点由本线程回收。先放弃所有权再摘除，
+    // 这样插入者之后不会再把这些节点链入任何一层
+    std::vector<node*> owned;
+    for (node* x : popped) {
+      if (x->owners.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        owned.push_back(x);
+      }
+    }
+    unlink_prefix(popped.back()->key);  // 所有被删除的键都不大于它
+    for (node* x : owned) domain.retire(x, &node::destroy);
+    for (node* x : popped) f(x->key, x->value);  // epoch_guard 保证尚未释放
+    return popped.size();
+  }
+
+  bool find(const K& k, V& v) const {  // 未找到返回 false
+    epoch_guard g(domain);
+    node* n = lower_bound(k);
+    if (!n || !equal(n->key, k)) return false;
+    v = n->value;
+    return true;
+  }
+
+  bool empty() const {
+    epoch_guard g(domain);
+    for (node* n = ptr(head[0].load(std::memory_order_acquire)); n;) {
+      const std::uintptr_t next =
+          n->next()[0].load(std::memory_order_acquire);
+      if (!marked(next)) return false;
+      n = ptr(next);
+    }
+    return true;
+  }
+
+  bool contains(const K& k) const {
+    epoch_guard g(domain);
+    node* n = lower_bound(k);
+    return n && equal(n->key, k);
+  }
+
+  // 按顺序对 [lo, hi) 中的键值调用 f(k, v)，f 返回 false 时提前结束。
+  // 遍历期间其他线程的插入和删除可能可见也可能不可见
+  template <typename F>
+  void for_each_range(const K& lo, const K& hi, F f) const {
+    epoch_guard g(domain);
+    for (node* n = lower_bound(lo); n && comp(n->key, hi);) {
+      const std::uintptr_t next =
+          n->next()[0].load(std::memory_order_acquire);
+      if (!marked(next) && !f(n->key, n->value)) return;
+      n = ptr(next);
+    }
+  }
+
+  template <typename F>
+  void for_each(F f) const {  // 按顺序遍历所有键值，f 返回 false 时提前结束
+    epoch_guard g(domain);
+    for (node* n = ptr(head[0].load(std::memory_order_acquire)); n;) {
+      const std::uintptr_t next =
+          n->next()[0].load(std::memory_order_acquire);
+      if (!marked(next) && !f(n->key, n->value)) return;
+      n = ptr(next);
+    }
+  }
+};
@@ -0,0 +1,58 @@
+// lock_free_skip_list 的压力测试：多个线程在少量的键上反复插入、删除、
+// pop_front 和 pop_front_n，同一个键不断被删除后重新插入。结束后单线程
+// 检查键有序、不重复，成功插入的次数等于删除的次数加上剩余的个数。
+// 用 -fsanitize=thread 或 -fsanitize=address 编译可以发现回收过早的节点
+#include <atomic>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "lock_free_skip_list.hpp"
+
+int main() {
+  constexpr int threads = 4;
+  constexpr int keys = 5000;
+  constexpr int rounds = 200000;
+  lock_free_skip_list<int, int> list;
+  std::atomic<long> inserted{0}, removed{0};
+  std::vector<std::thread> v;
+  for (int t = 0; t < threads; ++t) {
+    v.emplace_back([&, t] {
+      std::mt19937 rng(t + 1);
+      long ins = 0, rem = 0;
+      for (int i = 0; i < rounds; ++i) {
+        const int k = static_cast<int>(rng() % keys);
+        int pk, pv;
+        const unsigned op = rng() % 8;
+        if (op < 3) {
+          ins += list.insert(k, k);
+        } else if (op < 5) {
+          rem += list.erase(k);
+        } else if (op == 5) {
+          rem += list.pop_front(pk, pv);
+        } else if (op == 6) {
+          rem += list.pop_front_n(4, [](const int&, const int&) {});
+        } else if (list.find(k, pv) && pv != k) {
+          std::printf("bad value %d\n", pv);
+        }
+      }
+      inserted += ins;
+      removed += rem;
+    });
+  }
+  for (auto& x : v) x.join();
+  long left = 0;
+  int prev = -1;
+  bool ok = true;
+  int k, x;
+  while (list.pop_front(k, x)) {
+    if (k <= prev || x != k) ok = false;
+    prev = k;
+    ++left;
+  }
+  ok = ok && list.empty() && inserted == removed + left;
+  std::printf("inserted %ld, removed %ld, left %ld: %s\n", inserted.load(),
+              removed.load(), left, ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// 放宽 FIFO 语义的 MultiQueue：由 n 个内部队列（分片）组成，
+// push 放入随机分片，pop 从两个随机分片中选队首时间戳较小的一个，
+// 从而把对单个头节点锁的竞争分散到多个缓存行
+template <typename T>
+class multi_queue {
+  static constexpr std::uint64_t empty_stamp =
+      std::numeric_limits<std::uint64_t>::max();
+
+  struct alignas(64) shard {  // 每个分片独占缓存行，避免伪共享
+    std::mutex m;
+    std::queue<std::pair<std::uint64_t, std::shared_ptr<T>>> q;
+    // 队首元素的时间戳，无锁读取，用于比较两个分片
+    std::atomic<std::uint64_t> front_stamp{empty_stamp};
+  };
+
+  std::unique_ptr<shard[]> shards;
+  const unsigned n;
+  alignas(64) std::atomic<unsigned> waiters{0};  // 阻塞在 cv 上的线程数
+  std::mutex wm;                                 // 只在等待和唤醒时使用
+  std::condition_variable cv;
+
+  static std::minstd_rand& rng() {  // 每个线程各自的随机数引擎
+    thread_local std::minstd_rand r(static_cast<unsigned>(
+        std::hash<std::thread::id>{}(std::this_thread::get_id())));
+    return r;
+  }
+
+  static std::uint64_t now() {
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+  }
+
+  unsigned random_shard() { return rng()() % n; }
+
+  // 调用者持有 s.m
+  std::shared_ptr<T> pop_front(shard& s) {
+    std::shared_ptr<T> res = std::move(s.q.front().second);
+    s.q.pop();
+    s.front_stamp.store(s.q.empty() ? empty_stamp : s.q.front().first,
+                        std::memory_order_relaxed);
+    return res;
+  }
+
+  std::shared_ptr<T> try_pop_shard(shard& s) {
+    std::lock_guard<std::mutex> l(s.m);
+    if (s.q.empty()) return std::shared_ptr<T>();
+    return pop_front(s);
+  }
+
+  std::shared_ptr<T> pop_any() {
+    for (int attempt = 0; attempt < 4; ++attempt) {
+      shard& a = shards[random_shard()];
+      shard& b = shards[random_shard()];
+      // 选择队首更早入队的分片，两个分片都为空则重新选
+      shard& s = a.front_stamp.load(std::memory_order_relaxed) <=
+                         b.front_stamp.load(std::memory_order_relaxed)
+                     ? a
+                     : b;
+      if (s.front_stamp.load(std::memory_order_relaxed) == empty_stamp) {
+        continue;
+      }
+      std::unique_lock<std::mutex> l(s.m, std::try_to_lock);
+      if (l && !s.q.empty()) return pop_front(s);  // 锁被占用说明有竞争者
+    }
+    // 随机选择多次失败，依次检查所有分片，保证有元素时一定能取到
+    const unsigned start = random_shard();
+    for (unsigned i = 0; i < n; ++i) {
+      shard& s = shards[(start + i) % n];
+      if (s.front_stamp.load(std::memory_order_relaxed) == empty_stamp) {
+        continue;
+      }
+      if (auto res = try_pop_shard(s)) return res;
+    }
+    return std::shared_ptr<T>();
+  }
+
+  std::shared_ptr<T> wait_pop_any() {
+    for (;;) {
+      if (auto res = pop_any()) return res;
+      std::unique_lock<std::mutex> l(wm);
+      // 与 push 中的 fence 配对：push 要么看到 waiters 不为零，
+      // 要么这里看到分片非空
+      waiters.fetch_add(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      cv.wait(l, [this] { return !empty(); });
+      waiters.fetch_sub(1);
+    }
+  }
+
+ public:
+  // 分片数默认为硬件线程数的两倍
+  explicit multi_queue(unsigned n_ = 2 * std::max(
+                           1u, std::thread::hardware_concurrency()))
+      : shards(new shard[std::max(2u, n_)]), n(std::max(2u, n_)) {}
+  multi_queue(const multi_queue&) = delete;
+  multi_queue& operator=(const multi_queue&) = delete;
+
+  void push(T x) {
+    std::shared_ptr<T> data(std::make_shared<T>(std::move(x)));
+    shard& s = shards[random_shard()];
+    {
+      std::lock_guard<std::mutex> l(s.m);
+      const std::uint64_t stamp = now();
+      if (s.q.empty()) s.front_stamp.store(stamp, std::memory_order_relaxed);
+      s.q.emplace(stamp, std::move(data));
+    }
+    // 没有等待者时不碰 wm，push 路径只有分片锁
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_relaxed)) {
+      std::lock_guard<std::mutex> l(wm);
+      cv.notify_one();
+    }
+  }
+
+  void wait_and_pop(T& x) { x = std::move(*wait_pop_any()); }
+
+  std::shared_ptr<T> wait_and_pop() { return wait_pop_any(); }
+
+  bool try_pop(T& x) {
+    std::shared_ptr<T> res = pop_any();
+    if (!res) return false;
+    x = std::move(*res);
+    return true;
+  }
+
+  std::shared_ptr<T> try_pop() { return pop_any(); }
+
+  bool empty() const {
+    for (unsigned i = 0; i < n; ++i) {
+      if (shards[i].front_stamp.load(std::memory_order_relaxed) !=
+          empty_stamp) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
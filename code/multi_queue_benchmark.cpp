@@ -0,0 +1,90 @@
+// multi_queue 与 thread_safe_queue 的吞吐量对比，以及 multi_queue 的 rank error
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "lock_based_queue.hpp"
+#include "multi_queue.hpp"
+
+// 树状数组，统计仍在队列中且小于 x 的元素个数
+class fenwick_tree {
+  std::vector<long> v;
+
+ public:
+  explicit fenwick_tree(std::size_t n) : v(n + 1) {}
+  void add(std::size_t i, long d) {
+    for (++i; i < v.size(); i += i & (~i + 1)) v[i] += d;
+  }
+  long prefix(std::size_t i) const {  // [0, i) 的和
+    long res = 0;
+    for (; i > 0; i -= i & (~i + 1)) res += v[i];
+    return res;
+  }
+};
+
+// 按 0..n-1 的顺序 push，再全部 pop，
+// rank error 为 pop 出的元素之前还有多少个更早入队的元素未被取出
+void measure_rank_error(unsigned shards, std::size_t n) {
+  multi_queue<std::size_t> q(shards);
+  fenwick_tree present(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    q.push(i);
+    present.add(i, 1);
+  }
+  double sum = 0;
+  long worst = 0;
+  std::size_t x;
+  while (q.try_pop(x)) {
+    const long rank = present.prefix(x);
+    present.add(x, -1);
+    sum += rank;
+    worst = std::max(worst, rank);
+  }
+  std::printf("shards=%u mean rank error=%.2f max rank error=%ld\n", shards,
+              sum / n, worst);
+}
+
+template <typename Queue>
+double throughput(Queue& q, unsigned producers, unsigned consumers,
+                  std::size_t per_producer) {
+  const std::size_t total = producers * per_producer;
+  std::atomic<std::size_t> consumed(0);
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < producers; ++i) {
+    threads.emplace_back([&] {
+      for (std::size_t j = 0; j < per_producer; ++j) q.push(int(j));
+    });
+  }
+  for (unsigned i = 0; i < consumers; ++i) {
+    threads.emplace_back([&] {
+      int x;
+      while (consumed.load(std::memory_order_relaxed) < total) {
+        if (q.try_pop(x)) consumed.fetch_add(1, std::memory_order_relaxed);
+      }
+    });
+  }
+  for (auto& x : threads) x.join();
+  const std::chrono::duration<double> d =
+      std::chrono::steady_clock::now() - start;
+  return total / d.count();
+}
+
+int main() {
+  for (unsigned shards : {2, 4, 8, 16, 32, 64}) {
+    measure_rank_error(shards, 1 << 16);
+  }
+  const std::size_t per_producer = 200000;
+  for (unsigned threads : {1, 2, 4, 8, 16, 32, 48}) {
+    thread_safe_queue<int> a;
+    multi_queue<int> b(2 * threads);
+    std::printf("%2u producers, %2u consumers: ", threads, threads);
+    std::printf("thread_safe_queue %.0f ops/s, ",
+                throughput(a, threads, threads, per_producer));
+    std::printf("multi_queue %.0f ops/s\n",
+                throughput(b, threads, threads, per_producer));
+  }
+}
@@ -1,10 +1,9 @@
-#include <algorithm>
-#include <functional>
 #include <iterator>
 #include <numeric>
-#include <thread>
 #include <vector>
 
+#include "partitioner.hpp"
+#include "worker_team.hpp"
 
 template <typename Iterator, typename T>
 struct accumulate_block {
@@ -14,27 +13,24 @@ struct accumulate_block {
 };
 
 template <typename Iterator, typename T>
-T parallel_accumulate(Iterator first, Iterator last, T init) {
+T parallel_accumulate(Iterator first, Iterator last, T init,
+                      grain_cost& cost = default_grain_cost<
+                          struct parallel_accumulate_tag, Iterator, T>()) {
   const unsigned long len = std::distance(first, last);
   if (!len) return init;
-  const unsigned long min_per_thread = 25;
-  const unsigned long max_threads = (len + min_per_thread - 1) / min_per_thread;
-  const unsigned long hardware_threads = std::thread::hardware_concurrency();
-  const unsigned long num_threads =
-      std::min(hardware_threads != 0 ? hardware_threads : 2, max_threads);
-  const unsigned long block_size = len / num_threads;
+  const partition p = make_partition(len, cost.get());
+  const unsigned long num_threads = p.num_threads;
+  const unsigned long last_len = len - p.block_size * (num_threads - 1);
+  const std::vector<Iterator> starts = block_starts(first, last, p);
   std::vector<T> res(num_threads);
-  std::vector<std::thread> threads(num_threads - 1);
-  Iterator block_start = first;
-  for (unsigned long i = 0; i < num_threads - 1; ++i) {
-    Iterator block_end = block_start;
-    std::advance(block_end, block_size);
-    threads[i] = std::thread(accumulate_block<Iterator, T>{}, block_start,
-                             block_end, std::ref(res[i]));
-    block_start = block_end;
-  }
-  accumulate_block<Iterator, T>()(block_start, last, res[num_threads - 1]);
-  std::for_each(threads.begin(), threads.end(),
-                std::mem_fn(&std::thread::join));
+  worker_team::instance().parallel_region(num_threads, [&](unsigned long i) {
+    if (i + 1 < num_threads) {
+      accumulate_block<Iterator, T>()(starts[i], starts[i + 1], res[i]);
+    } else {
+      cost.measure(last_len, [&] {
+        accumulate_block<Iterator, T>()(starts[i], last, res[i]);
+      });
+    }
+  });
   return std::accumulate(res.begin(), res.end(), init);
 }
\ No newline at end of file
@@ -1,22 +1,32 @@
-#include <future>
 #include <iterator>
 #include <numeric>
 
+#include "partitioner.hpp"
+#include "task_group.hpp"
+
 template <typename Iterator, typename T>
-T parallel_accumulate(Iterator first, Iterator last, T init) {
+T parallel_accumulate(Iterator first, Iterator last, T init,
+                      grain_cost& cost = default_grain_cost<
+                          struct parallel_accumulate_tag, Iterator, T>()) {
   const unsigned long len = std::distance(first, last);
-  const unsigned long max_chunk_size = 25;
+  const unsigned long max_chunk_size = grain_size(cost.get());
   if (len <= max_chunk_size) {
-    return std::accumulate(first, last, init);
+    return cost.measure(len,
+                        [&] { return std::accumulate(first, last, init); });
   } else {
     Iterator mid_point = first;
     std::advance(mid_point, len / 2);
-    std::future<T> first_half_res =
-        std::async(parallel_accumulate<Iterator, T>, first, mid_point, init);
-    // 如果递归调用抛出异常，由 std::async 创建的 std::future
-    // 将在异常传播时被析构
-    T second_half_res = parallel_accumulate(mid_point, last, T{});
-    // 如果异步任务抛出异常，get 就会捕获异常并重新抛出
-    return first_half_res.get() + second_half_res;
+    T first_half_res{};
+    T second_half_res{};
+    // 前一半可以被线程池中的其他线程窃取，后一半在当前线程执行。
+    // 任何一半抛出异常，parallel_invoke 都会等两者结束后重新抛出
+    parallel_invoke(
+        [&] {
+          second_half_res = parallel_accumulate(mid_point, last, T{}, cost);
+        },
+        [&] {
+          first_half_res = parallel_accumulate(first, mid_point, init, cost);
+        });
+    return first_half_res + second_half_res;
   }
 }
\ No newline at end of file
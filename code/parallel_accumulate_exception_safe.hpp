@@ -7,6 +7,8 @@
 #include <utility>
 #include <vector>
 
+#include "partitioner.hpp"
+
 template <typename Iterator, typename T>
 struct accumulate_block {
   T operator()(Iterator first, Iterator last) {
@@ -15,15 +17,16 @@ struct accumulate_block {
 };
 
 template <typename Iterator, typename T>
-T parallel_accumulate(Iterator first, Iterator last, T init) {
+T parallel_accumulate(Iterator first, Iterator last, T init,
+                      grain_cost& cost = default_grain_cost<
+                          struct parallel_accumulate_tag, Iterator, T>()) {
   const unsigned long len = std::distance(first, last);
   if (!len) return init;
-  const unsigned long min_per_thread = 25;
-  const unsigned long max_threads = (len + min_per_thread - 1) / min_per_thread;
-  const unsigned long hardware_threads = std::thread::hardware_concurrency();
-  const unsigned long num_threads =
-      std::min(hardware_threads != 0 ? hardware_threads : 2, max_threads);
-  const unsigned long block_size = len / num_threads;
+  // 每块创建一个线程，按创建线程的开销分块
+  const partition p = make_partition(len, cost.get(), spawn_cost_ns());
+  const unsigned long num_threads = p.num_threads;
+  const unsigned long block_size = p.block_size;
+  const unsigned long last_len = len - block_size * (num_threads - 1);
   std::vector<std::future<T>> fts(num_threads - 1);
   std::vector<std::thread> threads(num_threads - 1);
   Iterator block_start = first;
@@ -36,7 +39,9 @@ T parallel_accumulate(Iterator first, Iterator last, T init) {
     threads[i] = std::thread(std::move(pt), block_start, block_end);
     block_start = block_end;
   }
-  T last_res = accumulate_block<Iterator, T>{}(block_start, last);
+  T last_res = cost.measure(last_len, [&] {
+    return accumulate_block<Iterator, T>{}(block_start, last);
+  });
   std::for_each(threads.begin(), threads.end(),
                 std::mem_fn(&std::thread::join));
   T res = init;
@@ -1,30 +1,44 @@
 #include <algorithm>
-#include <atomic>
+#include <chrono>
 #include <exception>
 #include <future>
 #include <iterator>
-#include <thread>
+#include <stop_token>
 #include <vector>
 
-#include "threads_guard.hpp"
+#include "interruptible_thread.hpp"
+#include "partitioner.hpp"
+#include "worker_team.hpp"
 
+// 找到、出错或 token 被请求停止后，各线程在下一个检查点停止。
+// 每块分成几微秒长的段（见 check_interval）用 std::find 查找，
+// 段之间检查是否停止。被取消且没有找到时返回 last
 template <typename Iterator, typename T>
-Iterator parallel_find(Iterator first, Iterator last, T match) {
+Iterator parallel_find(Iterator first, Iterator last, T match,
+                       std::stop_token token,
+                       grain_cost& cost = default_grain_cost<
+                           struct parallel_find_tag, Iterator, T>()) {
   struct find_element {
-    void operator()(Iterator begin, Iterator end, T match,
-                    std::promise<Iterator>* res, std::atomic<bool>* done_flag) {
+    void operator()(Iterator begin, unsigned long len, T match,
+                    unsigned long interval, std::promise<Iterator>* res,
+                    std::stop_source* done) {
       try {
-        for (; begin != end && !done_flag->load(); ++begin) {
-          if (*begin == match) {
-            res->set_value(begin);
-            done_flag->store(true);
+        while (len && !done->stop_requested()) {
+          const unsigned long n = std::min(len, interval);
+          const Iterator end = std::next(begin, n);
+          const Iterator it = std::find(begin, end, match);
+          if (it != end) {
+            res->set_value(it);
+            done->request_stop();
             return;
           }
+          begin = end;
+          len -= n;
         }
       } catch (...) {
         try {
           res->set_exception(std::current_exception());
-          done_flag->store(true);
+          done->request_stop();
         } catch (...) {
         }
       }
@@ -34,29 +48,41 @@ Iterator parallel_find(Iterator first, Iterator last, T match) {
   if (!len) {
     return last;
   }
-  const unsigned long min_per_thread = 25;
-  const unsigned long max_threads = (len + min_per_thread - 1) / min_per_thread;
-  const unsigned long hardware_threads = std::thread::hardware_concurrency();
-  const unsigned long num_threads =
-      std::min(hardware_threads != 0 ? hardware_threads : 2, max_threads);
-  const unsigned long block_size = len / num_threads;
+  const partition p = make_partition(len, cost.get());
+  const unsigned long num_threads = p.num_threads;
+  const unsigned long last_len = len - p.block_size * (num_threads - 1);
+  const std::vector<Iterator> starts = block_starts(first, last, p);
+  const unsigned long interval = check_interval(cost.get());
   std::promise<Iterator> res;
-  std::atomic<bool> done_flag(false);
-  std::vector<std::thread> threads(num_threads - 1);
-  {
-    threads_guard g(threads);
-    Iterator block_start = first;
-    for (unsigned long i = 0; i < num_threads - 1; ++i) {
-      Iterator block_end = block_start;
-      std::advance(block_end, block_size);
-      threads[i] = std::thread(find_element{}, block_start, block_end, match,
-                               &res, &done_flag);
-      block_start = block_end;
+  std::stop_source done;
+  std::stop_callback link(std::move(token), [&done] { done.request_stop(); });
+  std::chrono::nanoseconds elapsed{};
+  worker_team::instance().parallel_region(num_threads, [&](unsigned long i) {
+    if (i + 1 < num_threads) {
+      find_element{}(starts[i], p.block_size, match, interval, &res,
+                     &done);
+      return;
     }
-    find_element()(block_start, last, match, &res, &done_flag);
-  }
-  if (!done_flag.load()) {
+    const auto start = std::chrono::steady_clock::now();
+    find_element{}(starts[i], last_len, match, interval, &res, &done);
+    elapsed = std::chrono::steady_clock::now() - start;
+  });
+  if (!done.stop_requested()) {
+    // 只有没找到时每一块都完整遍历过，耗时才能代表每个元素的开销
+    cost.record(last_len, elapsed);
     return last;
   }
-  return res.get_future().get();
-}
\ No newline at end of file
+  std::future<Iterator> f = res.get_future();
+  if (f.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+    return last;  // 被调用者取消
+  }
+  return f.get();
+}
+
+// 随当前线程的 stop_token（例如所在的 task_group 被取消）一起停止
+template <typename Iterator, typename T>
+Iterator parallel_find(Iterator first, Iterator last, T match,
+                       grain_cost& cost = default_grain_cost<
+                           struct parallel_find_tag, Iterator, T>()) {
+  return parallel_find(first, last, match, this_thread_stop_token, cost);
+}
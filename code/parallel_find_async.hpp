@@ -1,39 +1,87 @@
-#include <atomic>
-#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <exception>
 #include <future>
 #include <iterator>
+#include <stop_token>
 
+#include "interruptible_thread.hpp"
+#include "partitioner.hpp"
+#include "task_group.hpp"
+
+// 找到后请求停止 done，尚未开始的子任务直接跳过，正在查找的叶子任务
+// 在下一个检查点（见 check_interval）返回，结果通过 res 取回。
+// 不用 parallel_invoke：它在取消后抛出 thread_interrupted，每层递归都要
+// 捕获再抛出，几十层的栈展开比叶子任务停止本身慢得多。被取消的 wait
+// 只返回 false，递归逐层直接返回
 template <typename Iterator, typename T>
-Iterator parallel_find_impl(Iterator first, Iterator last, T match,
-                            std::atomic<bool>& done_flag) {
+void parallel_find_impl(Iterator first, Iterator last, T match,
+                        std::promise<Iterator>& res, std::stop_source& done,
+                        grain_cost& cost) {
   try {
     const unsigned long len = std::distance(first, last);
-    const unsigned long min_per_thread = 25;
+    const unsigned long min_per_thread = grain_size(cost.get());
     if (len < (2 * min_per_thread)) {
-      for (; first != last && !done_flag.load(); ++first) {
-        if (*first == match) {
-          done_flag = true;
-          return first;
+      const unsigned long interval = check_interval(cost.get());
+      const auto start = std::chrono::steady_clock::now();
+      for (unsigned long left = len; left;) {
+        if (done.stop_requested()) return;
+        const unsigned long n = std::min(left, interval);
+        const Iterator end = std::next(first, n);
+        const Iterator it = std::find(first, end, match);
+        if (it != end) {
+          try {
+            res.set_value(it);
+          } catch (const std::future_error&) {  // 其他线程同时找到
+          }
+          done.request_stop();
+          return;
         }
+        first = end;
+        left -= n;
       }
-      return last;
+      // 完整遍历过才记录耗时
+      cost.record(len, std::chrono::steady_clock::now() - start);
     } else {
       const Iterator mid_point = first + len / 2;
-      std::future<Iterator> async_res =
-          std::async(&parallel_find_impl<Iterator, T>, mid_point, last, match,
-                     std::ref(done_flag));
-      const Iterator direct_res =
-          parallel_find_impl(first, mid_point, match, done_flag);
-      return direct_res == mid_point ? async_res.get() : direct_res;
+      task_group g;
+      g.run(
+          [&] { parallel_find_impl(mid_point, last, match, res, done, cost); });
+      parallel_find_impl(first, mid_point, match, res, done, cost);
+      g.wait();
     }
   } catch (...) {
-    done_flag = true;
+    done.request_stop();
     throw;
   }
 }
 
+// 找到、出错或 token 被请求停止后，几微秒内停止所有子任务。
+// 被取消且没有找到时返回 last
+template <typename Iterator, typename T>
+Iterator parallel_find(Iterator first, Iterator last, T match,
+                       std::stop_token token,
+                       grain_cost& cost = default_grain_cost<
+                           struct parallel_find_tag, Iterator, T>()) {
+  std::promise<Iterator> res;
+  std::stop_source done;
+  std::stop_callback link(std::move(token), [&done] { done.request_stop(); });
+  try {
+    stop_token_scope scope(done.get_token());  // 之后创建的任务组随 done 取消
+    parallel_find_impl(first, last, match, res, done, cost);
+  } catch (const thread_interrupted&) {
+  }
+  std::future<Iterator> f = res.get_future();
+  if (f.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+    return last;
+  }
+  return f.get();
+}
+
+// 随当前线程的 stop_token（例如所在的 task_group 被取消）一起停止
 template <typename Iterator, typename T>
-Iterator parallel_find(Iterator first, Iterator last, T match) {
-  std::atomic<bool> done_flag(false);
-  return parallel_find_impl(first, last, match, done_flag);
-}
\ No newline at end of file
+Iterator parallel_find(Iterator first, Iterator last, T match,
+                       grain_cost& cost = default_grain_cost<
+                           struct parallel_find_tag, Iterator, T>()) {
+  return parallel_find(first, last, match, this_thread_stop_token, cost);
+}
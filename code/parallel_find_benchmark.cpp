@@ -0,0 +1,46 @@
+// 取消的延迟：每个元素耗时约 1 微秒，超时后请求停止，测量 parallel_find
+// 从请求停止到返回的时间。默认测试 parallel_find.hpp（常驻线程组），
+// 定义 ASYNC 时测试 parallel_find_async.hpp（task_group 递归划分）
+#include <chrono>
+#include <cstdio>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#ifdef ASYNC
+#include "parallel_find_async.hpp"
+#else
+#include "parallel_find.hpp"
+#endif
+
+struct slow {
+  int x;
+  bool operator==(int m) const {
+    const auto end =
+        std::chrono::steady_clock::now() + std::chrono::microseconds(1);
+    while (std::chrono::steady_clock::now() < end) {
+    }
+    return x == m;
+  }
+};
+
+int main() {
+  std::vector<slow> v(1 << 24);
+  static grain_cost cost(1000);  // 提示每个元素 1 微秒
+  for (int timeout_ms : {1, 10, 100}) {
+    std::stop_source s;
+    std::chrono::steady_clock::time_point stopped;
+    std::thread timer([&] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+      stopped = std::chrono::steady_clock::now();
+      s.request_stop();
+    });
+    const bool found =
+        parallel_find(v.begin(), v.end(), 1, s.get_token(), cost) != v.end();
+    const auto returned = std::chrono::steady_clock::now();
+    timer.join();
+    const std::chrono::duration<double, std::micro> d = returned - stopped;
+    std::printf("timeout %3d ms: returned %8.1f us after stop (%d)\n",
+                timeout_ms, d.count(), found);
+  }
+}
@@ -1,39 +1,100 @@
 #include <algorithm>
-#include <future>
+#include <atomic>
+#include <chrono>
 #include <iterator>
-#include <thread>
-#include <utility>
 #include <vector>
 
-#include "threads_guard.hpp"
+#include "partitioner.hpp"
+#include "worker_team.hpp"
+
+// 调度方式：
+// - static_blocks：平分为 num_threads 块，每个元素开销相近时最快
+// - dynamic(chunk)：线程从共享的原子计数器每次领取 chunk 个元素，
+//   chunk 为 0 时取每个线程约 8 块
+// - guided(min_chunk)：每次领取剩余元素的 1 / (2 * num_threads)，块逐渐变小，
+//   但不小于 min_chunk，领取次数比 dynamic 少，结尾的负载同样均衡
+// 后两者适合每个元素开销相差很大的情况，最后一个线程不会比其他线程晚结束太多
+struct schedule {
+  enum class kind { static_blocks, dynamic, guided };
+  kind type = kind::static_blocks;
+  unsigned long chunk = 0;
+
+  static schedule static_blocks() { return {}; }
+  static schedule dynamic(unsigned long chunk = 0) {
+    return {kind::dynamic, chunk};
+  }
+  static schedule guided(unsigned long min_chunk = 1) {
+    return {kind::guided, std::max(1ul, min_chunk)};
+  }
+};
 
 template <typename Iterator, typename Func>
-void parallel_for_each(Iterator first, Iterator last, Func f) {
+void parallel_for_each(
+    Iterator first, Iterator last, Func f, schedule s,
+    grain_cost& cost = default_grain_cost<
+        struct parallel_for_each_tag, Iterator, Func>()) {
   const unsigned long len = std::distance(first, last);
   if (!len) {
     return;
   }
-  const unsigned long min_per_thread = 25;
-  const unsigned long max_threads = (len + min_per_thread - 1) / min_per_thread;
-  const unsigned long hardware_threads = std::thread::hardware_concurrency();
-  const unsigned long num_threads =
-      std::min(hardware_threads != 0 ? hardware_threads : 2, max_threads);
-  const unsigned long block_size = len / num_threads;
-  std::vector<std::future<void>> fts(num_threads - 1);
-  std::vector<std::thread> threads(num_threads - 1);
-  threads_guard g(threads);
-  Iterator block_start = first;
-  for (unsigned long i = 0; i < num_threads - 1; ++i) {
-    Iterator block_end = block_start;
-    std::advance(block_end, block_size);
-    std::packaged_task<void(void)> pt(
-        [=] { std::for_each(block_start, block_end, f); });
-    fts[i] = pt.get_future();
-    threads[i] = std::thread(std::move(pt));
-    block_start = block_end;
-  }
-  std::for_each(block_start, last, f);
-  for (unsigned long i = 0; i < num_threads - 1; ++i) {
-    fts[i].get();  // 只是为了传递异常
+  const partition p = make_partition(len, cost.get());
+  const unsigned long num_threads = p.num_threads;
+  if (s.type == schedule::kind::static_blocks || num_threads == 1) {
+    const unsigned long last_len = len - p.block_size * (num_threads - 1);
+    const std::vector<Iterator> starts = block_starts(first, last, p);
+    // 异常由 parallel_region 在所有块完成后传给调用者
+    worker_team::instance().parallel_region(num_threads, [&](unsigned long i) {
+      if (i + 1 < num_threads) {
+        std::for_each(starts[i], starts[i + 1], f);
+      } else {
+        cost.measure(last_len, [&] { std::for_each(starts[i], last, f); });
+      }
+    });
+    return;
   }
-}
\ No newline at end of file
+  const unsigned long chunk =
+      s.chunk ? s.chunk : std::max(1ul, len / (num_threads * 8));
+  std::atomic<unsigned long> next(0);  // 下一个未被领取的元素
+  auto claim = [&](unsigned long& begin, unsigned long& end) {
+    unsigned long b = next.load(std::memory_order_relaxed);
+    unsigned long n;
+    do {
+      if (b >= len) return false;
+      n = s.type == schedule::kind::dynamic
+              ? chunk
+              : std::max({1ul, s.chunk, (len - b) / (2 * num_threads)});
+    } while (!next.compare_exchange_weak(b, b + n, std::memory_order_relaxed));
+    begin = b;
+    end = std::min(len, b + n);
+    return true;
+  };
+  // 异常同样由 parallel_region 传给调用者。抛出异常的线程不再领取，
+  // 与静态分块时一样，其他线程处理完未领取的元素后才返回
+  worker_team::instance().parallel_region(num_threads, [&](unsigned long i) {
+    // 领取的位置递增，每个线程只需从上次的位置向前移动迭代器
+    Iterator it = first;
+    unsigned long pos = 0;
+    unsigned long processed = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned long b, e; claim(b, e);) {
+      std::advance(it, b - pos);
+      Iterator block_end = std::next(it, e - b);
+      std::for_each(it, block_end, f);
+      it = block_end;
+      pos = e;
+      processed += e - b;
+    }
+    if (i + 1 == num_threads) {
+      cost.record(processed, std::chrono::steady_clock::now() - start);
+    }
+  });
+}
+
+template <typename Iterator, typename Func>
+void parallel_for_each(
+    Iterator first, Iterator last, Func f,
+    grain_cost& cost = default_grain_cost<
+        struct parallel_for_each_tag, Iterator, Func>()) {
+  parallel_for_each(first, last, std::move(f), schedule::static_blocks(),
+                    cost);
+}
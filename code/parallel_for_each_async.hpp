@@ -1,21 +1,25 @@
 #include <algorithm>
-#include <future>
 #include <iterator>
 
+#include "partitioner.hpp"
+#include "task_group.hpp"
+
 template <typename Iterator, typename Func>
-void parallel_for_each(Iterator first, Iterator last, Func f) {
+void parallel_for_each(
+    Iterator first, Iterator last, Func f,
+    grain_cost& cost = default_grain_cost<
+        struct parallel_for_each_tag, Iterator, Func>()) {
   const unsigned long len = std::distance(first, last);
   if (!len) {
     return;
   }
-  const unsigned long min_per_thread = 25;
+  const unsigned long min_per_thread = grain_size(cost.get());
   if (len < 2 * min_per_thread) {
-    std::for_each(first, last, f);
+    cost.measure(len, [&] { std::for_each(first, last, f); });
   } else {
     const Iterator mid_point = first + len / 2;
-    std::future<void> first_half =
-        std::async(&parallel_for_each<Iterator, Func>, first, mid_point, f);
-    parallel_for_each(mid_point, last, f);
-    first_half.get();
+    // 后一半在当前线程执行，前一半可以被其他线程窃取，线程数不随递归增加
+    parallel_invoke([&] { parallel_for_each(mid_point, last, f, cost); },
+                    [&] { parallel_for_each(first, mid_point, f, cost); });
   }
 }
\ No newline at end of file
@@ -0,0 +1,34 @@
+// 开销不均匀时三种调度方式的对比：前 1/8 的元素开销是其余元素的 100 倍，
+// 静态分块时第一个块的线程最后结束
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <vector>
+
+#include "parallel_for_each.hpp"
+
+int main() {
+  std::vector<unsigned> v(1 << 16);
+  auto work = [n = v.size()](unsigned& x) {
+    const unsigned rounds = x < n / 8 ? 10000 : 100;
+    unsigned h = x;
+    for (unsigned i = 0; i < rounds; ++i) h = h * 1664525u + 1013904223u;
+    x = h;
+  };
+  const struct {
+    const char* name;
+    schedule s;
+  } cases[] = {{"static", schedule::static_blocks()},
+               {"dynamic", schedule::dynamic()},
+               {"dynamic(64)", schedule::dynamic(64)},
+               {"guided", schedule::guided()}};
+  for (const auto& c : cases) {
+    std::iota(v.begin(), v.end(), 0u);
+    grain_cost cost(1000);  // 每种调度单独估计，避免相互影响
+    const auto start = std::chrono::steady_clock::now();
+    parallel_for_each(v.begin(), v.end(), work, c.s, cost);
+    const std::chrono::duration<double, std::milli> d =
+        std::chrono::steady_clock::now() - start;
+    std::printf("%-12s %10.3f ms\n", c.name, d.count());
+  }
+}
@@ -1,75 +1,314 @@
 #include <algorithm>
-#include <future>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <exception>
+#include <functional>
 #include <iterator>
+#include <memory>  // for std::to_address
 #include <numeric>
 #include <thread>
+#include <type_traits>
 #include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
-#include "threads_guard.hpp"
+#include "partitioner.hpp"
+#include "worker_team.hpp"
 
-template <typename Iterator>
-void parallel_partial_sum(Iterator first, Iterator last) {
-  using value_type = typename Iterator::value_type;
-  struct process_chunk {
-    void operator()(Iterator begin, Iterator last,
-                    std::future<value_type>* previous_end_value,
-                    std::promise<value_type>* end_value) {
+#if defined(__SSE2__)
+// 整数的加法在有符号和无符号时相同，按元素大小选择指令
+template <std::size_t Size>
+inline __m128i add_lanes(__m128i a, __m128i b) {
+  if constexpr (Size == 1) {
+    return _mm_add_epi8(a, b);
+  } else if constexpr (Size == 2) {
+    return _mm_add_epi16(a, b);
+  } else if constexpr (Size == 4) {
+    return _mm_add_epi32(a, b);
+  } else {
+    return _mm_add_epi64(a, b);
+  }
+}
+
+template <std::size_t Size>
+inline __m128i broadcast_last(__m128i x) {  // 把最后一个元素复制到所有位置
+  if constexpr (Size == 1) {
+    x = _mm_unpackhi_epi8(x, x);
+  }
+  if constexpr (Size <= 2) {
+    x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(3, 3, 3, 3));
+  }
+  if constexpr (Size <= 4) {
+    return _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+  } else {
+    return _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 2, 3, 2));
+  }
+}
+
+template <typename T>
+inline __m128i set_lanes(T x) {
+  if constexpr (sizeof(T) == 1) {
+    return _mm_set1_epi8(static_cast<char>(x));
+  } else if constexpr (sizeof(T) == 2) {
+    return _mm_set1_epi16(static_cast<short>(x));
+  } else if constexpr (sizeof(T) == 4) {
+    return _mm_set1_epi32(static_cast<int>(x));
+  } else {
+    return _mm_set1_epi64x(static_cast<long long>(x));
+  }
+}
+
+template <typename T>
+concept simd_integer = std::integral<T> && !std::is_same_v<T, bool> &&
+                       sizeof(T) <= 8;
+
+// 寄存器内的前缀和：x 左移一个元素后与自身相加，再左移两个、四个……元素相加，
+// 得到各元素的前缀和，加上前面的进位后把最后一个元素广播为新的进位
+template <simd_integer T>
+inline void simd_scan(T* p, std::size_t n, T carry) {
+  constexpr std::size_t size = sizeof(T);
+  constexpr std::size_t lanes = 16 / size;
+  __m128i c = set_lanes(carry);
+  std::size_t i = 0;
+  for (; i + lanes <= n; i += lanes) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+    if constexpr (size <= 1) x = add_lanes<size>(x, _mm_slli_si128(x, 1));
+    if constexpr (size <= 2) x = add_lanes<size>(x, _mm_slli_si128(x, 2));
+    if constexpr (size <= 4) x = add_lanes<size>(x, _mm_slli_si128(x, 4));
+    x = add_lanes<size>(x, _mm_slli_si128(x, 8));
+    x = add_lanes<size>(x, c);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p + i), x);
+    c = broadcast_last<size>(x);
+  }
+  if (i) carry = p[i - 1];
+  for (; i < n; ++i) p[i] = carry += p[i];
+}
+
+inline void simd_scan(float* p, std::size_t n, float carry) {
+  __m128 c = _mm_set1_ps(carry);
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 x = _mm_loadu_ps(p + i);
+    x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 4)));
+    x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 8)));
+    x = _mm_add_ps(x, c);
+    _mm_storeu_ps(p + i, x);
+    c = _mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 3, 3, 3));
+  }
+  carry = _mm_cvtss_f32(c);
+  for (; i < n; ++i) p[i] = carry += p[i];
+}
+
+inline void simd_scan(double* p, std::size_t n, double carry) {
+  __m128d c = _mm_set1_pd(carry);
+  std::size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    __m128d x = _mm_loadu_pd(p + i);
+    x = _mm_add_pd(x, _mm_castsi128_pd(_mm_slli_si128(_mm_castpd_si128(x), 8)));
+    x = _mm_add_pd(x, c);
+    _mm_storeu_pd(p + i, x);
+    c = _mm_unpackhi_pd(x, x);
+  }
+  carry = _mm_cvtsd_f64(c);
+  for (; i < n; ++i) p[i] = carry += p[i];
+}
+
+// 归约用一个向量寄存器中的多个部分和，最后再合并
+template <simd_integer T>
+inline T simd_reduce(const T* p, std::size_t n) {
+  constexpr std::size_t lanes = 16 / sizeof(T);
+  __m128i s = _mm_setzero_si128();
+  std::size_t i = 0;
+  for (; i + lanes <= n; i += lanes) {
+    s = add_lanes<sizeof(T)>(
+        s, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)));
+  }
+  alignas(16) T partial[lanes];
+  _mm_store_si128(reinterpret_cast<__m128i*>(partial), s);
+  T res = 0;
+  for (T x : partial) res += x;
+  for (; i < n; ++i) res += p[i];
+  return res;
+}
+
+inline float simd_reduce(const float* p, std::size_t n) {
+  __m128 s = _mm_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) s = _mm_add_ps(s, _mm_loadu_ps(p + i));
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s = _mm_add_ss(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 1, 1, 1)));
+  float res = _mm_cvtss_f32(s);
+  for (; i < n; ++i) res += p[i];
+  return res;
+}
+
+inline double simd_reduce(const double* p, std::size_t n) {
+  __m128d s = _mm_setzero_pd();
+  std::size_t i = 0;
+  for (; i + 2 <= n; i += 2) s = _mm_add_pd(s, _mm_loadu_pd(p + i));
+  double res = _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+  for (; i < n; ++i) res += p[i];
+  return res;
+}
+#endif
+
+// 一块数据的归约和扫描。连续存储的整数（bool 除外，8 到 64 位，有无符号均可）、
+// float、double 用加法时使用 SIMD，浮点数的结合顺序因此与顺序计算不同，
+// 结果可能有舍入误差上的差异
+template <typename Iterator, typename BinaryOp>
+struct scan_kernel {
+  using value_type = typename std::iterator_traits<Iterator>::value_type;
+
+#if defined(__SSE2__)
+  static constexpr bool simd =
+      std::contiguous_iterator<Iterator> &&
+      (std::is_same_v<BinaryOp, std::plus<>> ||
+       std::is_same_v<BinaryOp, std::plus<value_type>>)&&(
+          simd_integer<value_type> || std::is_same_v<value_type, float> ||
+          std::is_same_v<value_type, double>);
+#else
+  static constexpr bool simd = false;
+#endif
+
+  static value_type reduce(Iterator begin, Iterator end, BinaryOp& op) {
+#if defined(__SSE2__)
+    if constexpr (simd) {
+      return simd_reduce(std::to_address(begin), end - begin);
+    }
+#endif
+    value_type s = *begin;
+    for (++begin; begin != end; ++begin) s = op(s, *begin);
+    return s;
+  }
+
+  static void scan(Iterator begin, Iterator end, BinaryOp& op) {
+#if defined(__SSE2__)
+    if constexpr (simd) {
+      return simd_scan(std::to_address(begin), end - begin, value_type(0));
+    }
+#endif
+    std::inclusive_scan(begin, end, begin, op);
+  }
+
+  static void scan(Iterator begin, Iterator end, BinaryOp& op,
+                   value_type carry) {
+#if defined(__SSE2__)
+    if constexpr (simd) {
+      return simd_scan(std::to_address(begin), end - begin, carry);
+    }
+#endif
+    std::inclusive_scan(begin, end, begin, op, std::move(carry));
+  }
+};
+
+// 单遍的并行前缀和（decoupled look-back）：数据分成能放进缓存的块，
+// 线程按顺序领取块。每块先求总和并公布（状态 A），再从前一块往前回看：
+// 遇到 A 就累加其总和继续往前，遇到 P（已知包含该块的前缀和）就停止，
+// 得到本块之前的前缀后公布本块的前缀（状态 P），最后以其为初值扫描本块。
+// 不必等待前一块扫描完，第二遍读取时块还在缓存中，内存访问接近一读一写。
+// op 只需满足结合律，不要求交换律
+template <typename Iterator, typename BinaryOp = std::plus<>>
+void parallel_partial_sum(
+    Iterator first, Iterator last, BinaryOp op = BinaryOp{},
+    grain_cost& cost = default_grain_cost<
+        struct parallel_partial_sum_tag, Iterator, BinaryOp>()) {
+  using value_type = typename std::iterator_traits<Iterator>::value_type;
+  using kernel = scan_kernel<Iterator, BinaryOp>;
+  enum : int { not_ready, aggregate_ready, prefix_ready, failed_tile };
+  struct alignas(64) tile_state {
+    std::atomic<int> status{not_ready};
+    value_type aggregate{};  // 本块的总和，状态为 A 后可读
+    value_type prefix{};     // 包含本块的前缀和，状态为 P 后可读
+  };
+
+  const std::size_t len = std::distance(first, last);
+  if (len <= 1) {
+    return;
+  }
+  // 每块约 64KB，扫描时仍在 L2 缓存中
+  const std::size_t tile_size =
+      std::max<std::size_t>(1024, 65536 / sizeof(value_type));
+  const std::size_t num_tiles = (len + tile_size - 1) / tile_size;
+  const unsigned long num_threads = std::min<std::size_t>(
+      make_partition(len, cost.get()).num_threads, num_tiles);
+  if (num_threads == 1) {
+    cost.measure(len, [&] { kernel::scan(first, last, op); });
+    return;
+  }
+
+  std::vector<tile_state> tiles(num_tiles);
+  std::atomic<std::size_t> next_tile(0);
+  std::atomic<bool> failed(false);
+  std::vector<std::exception_ptr> errors(num_threads);
+
+  auto process_tile = [&](std::size_t i) {
+    tile_state& t = tiles[i];
+    const Iterator begin = std::next(first, i * tile_size);
+    const Iterator end =
+        std::next(begin, std::min(len - i * tile_size, tile_size));
+    if (i == 0) {
+      kernel::scan(begin, end, op);
+      t.prefix = *std::prev(end);
+      t.status.store(prefix_ready, std::memory_order_release);
+      return;
+    }
+    t.aggregate = kernel::reduce(begin, end, op);
+    t.status.store(aggregate_ready, std::memory_order_release);
+    // 回看：前面的块都已被领取，因此一定会取得进展
+    value_type exclusive{};
+    bool has_exclusive = false;
+    for (std::size_t j = i; j-- > 0;) {
+      int s;
+      while ((s = tiles[j].status.load(std::memory_order_acquire)) ==
+             not_ready) {
+        std::this_thread::yield();
+      }
+      if (s == failed_tile) {  // 前面的块失败，本块随之失败，不再等待
+        t.status.store(failed_tile, std::memory_order_release);
+        return;
+      }
+      const value_type& v =
+          s == prefix_ready ? tiles[j].prefix : tiles[j].aggregate;
+      exclusive = has_exclusive ? op(v, exclusive) : v;
+      has_exclusive = true;
+      if (s == prefix_ready) break;
+    }
+    t.prefix = op(exclusive, t.aggregate);
+    t.status.store(prefix_ready, std::memory_order_release);
+    kernel::scan(begin, end, op, std::move(exclusive));
+  };
+
+  // 调用线程（w 为 num_threads - 1）记录处理过的元素数和耗时
+  std::size_t measured_elements = 0;
+  std::chrono::nanoseconds measured_time{};
+  auto worker = [&](unsigned long w) {
+    for (;;) {
+      if (failed.load(std::memory_order_relaxed)) return;
+      const std::size_t i = next_tile.fetch_add(1);
+      if (i >= num_tiles) return;
       try {
-        Iterator end = last;
-        ++end;
-        std::partial_sum(begin, end, begin);
-        if (previous_end_value)  // 不是第一个块
-        {
-          value_type addend = previous_end_value->get();
-          *last += addend;
-          if (end_value) end_value->set_value(*last);
-          std::for_each(begin, last,
-                        [addend](value_type& item) { item += addend; });
-        } else if (end_value) {  // 是第一个块则可以为下个块更新尾元素
-          end_value->set_value(*last);
+        if (w + 1 < num_threads) {
+          process_tile(i);
+          continue;
         }
+        const auto start = std::chrono::steady_clock::now();
+        process_tile(i);
+        measured_time += std::chrono::steady_clock::now() - start;
+        measured_elements += std::min(len - i * tile_size, tile_size);
       } catch (...) {
-        // 如果抛出异常则存储到
-        // std::promise，异常会传播给下一个块（获取这个块的尾元素时）
-        if (end_value) {
-          end_value->set_exception(std::current_exception());
-        } else {
-          throw;  // 异常最终传给最后一个块，此时再抛出异常
-        }
+        // 标记失败，回看到本块的后续块随之失败，不会一直等待
+        if (!errors[w]) errors[w] = std::current_exception();
+        failed = true;
+        tiles[i].status.store(failed_tile, std::memory_order_release);
       }
     }
   };
-  const unsigned long len = std::distance(first, last);
-  if (!len) {
-    return;
-  }
-  const unsigned long min_per_thread = 25;
-  const unsigned long max_threads = (len + min_per_thread - 1) / min_per_thread;
-  const unsigned long hardware_threads = std::thread::hardware_concurrency();
-  const unsigned long num_threads =
-      std::min(hardware_threads != 0 ? hardware_threads : 2, max_threads);
-  const unsigned long block_size = len / num_threads;
-  std::vector<std::thread> threads(num_threads - 1);
-  std::vector<std::promise<value_type>> end_values(num_threads -
-                                                   1);  // 存储块内尾元素值
-  std::vector<std::future<value_type>>
-      previous_end_values;  // 检索前一个块的尾元素
-  previous_end_values.reserve(num_threads - 1);
-  threads_guard g(threads);
-  Iterator block_start = first;
-  for (unsigned long i = 0; i < num_threads - 1; ++i) {
-    Iterator block_last = block_start;
-    std::advance(block_last, block_size - 1);  // 指向尾元素
-    threads[i] = std::thread(process_chunk{}, block_start, block_last,
-                             i != 0 ? &previous_end_values[i - 1] : nullptr,
-                             &end_values[i]);
-    block_start = block_last;
-    ++block_start;
-    previous_end_values.emplace_back(end_values[i].get_future());
+  worker_team::instance().parallel_region(num_threads, worker);
+  for (auto& x : errors) {
+    if (x) std::rethrow_exception(x);
   }
-  Iterator final_element = block_start;
-  std::advance(final_element, std::distance(block_start, last) - 1);
-  process_chunk{}(block_start, final_element,
-                  num_threads > 1 ? &previous_end_values.back() : nullptr,
-                  nullptr);
-}
\ No newline at end of file
+  cost.record(measured_elements, measured_time);
+}
@@ -1,46 +1,91 @@
+#include <atomic>
+#include <exception>
 #include <functional>
 #include <iterator>
-#include <thread>
+#include <numeric>
 #include <vector>
 
 #include "barrier.hpp"
-#include "threads_guard.hpp"
+#include "partitioner.hpp"
+#include "worker_team.hpp"
 
-template <typename Iterator>
-void parallel_partial_sum(Iterator first, Iterator last) {
-  using value_type = typename Iterator::value_type;
-  struct process_element {
-    void operator()(Iterator first, Iterator last, std::vector<value_type>& v,
-                    unsigned i, barrier& b) {
-      value_type& ith_element = *(first + i);
-      bool update_source = false;
-      for (unsigned step = 0, stride = 1; stride <= i; ++step, stride *= 2) {
-        const value_type& source = step % 2 ? v[i] : ith_element;
-        value_type& dest = step % 2 ? ith_element : v[i];
-        const value_type& addend =
-            step % 2 ? v[i - stride] : *(first + i - stride);
-        dest = source + addend;
-        update_source = !(step % 2);
-        b.wait();
-      }
-      if (update_source) {
-        ith_element = v[i];
-      }
-      b.done_waiting();
-    }
-  };
+// 分块的并行前缀和（先归约再扫描），总计算量为 O(n)：
+// 1. 每个线程求出自己那一块的总和（最后一块不需要）
+// 2. 所有线程在 barrier 处同步一次
+// 3. 每个线程把前面各块的总和合并为偏移量，以此为初值扫描自己的块
+// 与先扫描再加偏移相比，每个元素只写一次。op 只需满足结合律，不要求交换律
+template <typename Iterator, typename BinaryOp = std::plus<>>
+void parallel_partial_sum(
+    Iterator first, Iterator last, BinaryOp op = BinaryOp{},
+    grain_cost& cost = default_grain_cost<
+        struct parallel_partial_sum_tag, Iterator, BinaryOp>()) {
+  using value_type = typename std::iterator_traits<Iterator>::value_type;
   const unsigned long len = std::distance(first, last);
   if (len <= 1) {
     return;
   }
-  std::vector<value_type> v(len);
-  barrier b(len);
-  std::vector<std::thread> threads(len - 1);
-  threads_guard g(threads);
-  Iterator block_start = first;
-  for (unsigned long i = 0; i < len - 1; ++i) {
-    threads[i] = std::thread(process_element{}, first, last, std::ref(v), i,
-                             std::ref(b));
+  // 每个元素在归约和扫描中各被 op 处理一次，按扫描的耗时估计
+  const unsigned long num_threads = make_partition(len, cost.get()).num_threads;
+  if (num_threads == 1) {
+    cost.measure(len, [&] { std::inclusive_scan(first, last, first, op); });
+    return;
+  }
+  std::vector<value_type> sums(num_threads - 1);  // 每一块的总和
+  std::vector<std::exception_ptr> errors(num_threads);
+  std::atomic<bool> failed(false);
+  barrier b(num_threads);
+  // 还没有到达 barrier 就离开（出错或抛出异常）时退出同步，
+  // 任何路径上其他线程都不会一直等待
+  struct arrive_guard {
+    barrier& b;
+    bool arrived = false;
+    void wait() {
+      arrived = true;
+      b.wait();
+    }
+    ~arrive_guard() {
+      if (!arrived) b.done_waiting();
+    }
+  };
+  auto process_chunk = [&](unsigned long i) {
+    arrive_guard g{b};
+    const Iterator begin = first + len * i / num_threads;
+    const Iterator end = first + len * (i + 1) / num_threads;
+    if (i + 1 < num_threads) {
+      try {
+        value_type s = *begin;
+        for (Iterator it = std::next(begin); it != end; ++it) s = op(s, *it);
+        sums[i] = std::move(s);
+      } catch (...) {
+        errors[i] = std::current_exception();
+        failed = true;
+        return;
+      }
+    }
+    g.wait();
+    if (failed.load()) return;
+    try {
+      if (i == 0) {
+        std::inclusive_scan(begin, end, begin, op);
+      } else {
+        value_type offset = sums[0];
+        for (unsigned long j = 1; j < i; ++j) offset = op(offset, sums[j]);
+        auto scan = [&] {
+          std::inclusive_scan(begin, end, begin, op, std::move(offset));
+        };
+        if (i + 1 < num_threads) {
+          scan();
+        } else {  // 调用线程的块没有归约，只计扫描的耗时
+          cost.measure(end - begin, scan);
+        }
+      }
+    } catch (...) {
+      errors[i] = std::current_exception();
+    }
+  };
+  // 各块同时运行，barrier 才不会一直等待
+  worker_team::instance().parallel_region(num_threads, process_chunk);
+  for (auto& x : errors) {
+    if (x) std::rethrow_exception(x);
   }
-  process_element{}(first, last, v, len - 1, b);
-}
\ No newline at end of file
+}
@@ -0,0 +1,46 @@
+// parallel_partial_sum 与 std::inclusive_scan 对比，默认测试
+// parallel_partial_sum_2.hpp（先归约再扫描），
+// 定义 LOOK_BACK 时测试 parallel_partial_sum.hpp（单遍 decoupled look-back）
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <vector>
+
+#ifdef LOOK_BACK
+#include "parallel_partial_sum.hpp"
+#else
+#include "parallel_partial_sum_2.hpp"
+#endif
+
+template <typename T, typename F>
+double run_ms(std::vector<T>& v, F f) {
+  std::iota(v.begin(), v.end(), T(1));
+  const auto start = std::chrono::steady_clock::now();
+  f(v);
+  const std::chrono::duration<double, std::milli> d =
+      std::chrono::steady_clock::now() - start;
+  return d.count();
+}
+
+template <typename T>
+void compare(const char* type, std::size_t n) {
+  std::vector<T> a(n), b(n);
+  const double seq = run_ms(a, [](std::vector<T>& v) {
+    std::inclusive_scan(v.begin(), v.end(), v.begin());
+  });
+  const double par = run_ms(
+      b, [](std::vector<T>& v) { parallel_partial_sum(v.begin(), v.end()); });
+  std::printf("%-8s %10zu %12.3f %12.3f %s\n", type, n, seq, par,
+              a == b ? "" : "mismatch");
+}
+
+int main() {
+  std::printf("%-8s %10s %12s %12s\n", "type", "n", "std (ms)",
+              "parallel (ms)");
+  for (std::size_t n : {1000, 100000, 1000000, 10000000}) {
+    compare<int>("int", n);
+    compare<long>("long", n);
+    compare<unsigned short>("ushort", n);
+    compare<double>("double", n);
+  }
+}
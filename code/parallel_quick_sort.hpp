@@ -1,13 +1,21 @@
 #include <algorithm>
-#include <future>
 #include <list>
 #include <utility>
 
+#include "partitioner.hpp"
+#include "task_group.hpp"
+
 template <typename T>
 std::list<T> parallel_quick_sort(std::list<T> v) {
   if (v.empty()) {
     return v;
   }
+  // 元素太少时划分任务的开销超过并行的收益，直接顺序排序
+  grain_cost& cost = default_grain_cost<struct parallel_quick_sort_tag, T>();
+  if (v.size() < grain_size(cost.get())) {
+    cost.measure(v.size(), [&] { v.sort(); });
+    return v;
+  }
   std::list<T> res;
   res.splice(res.begin(), v, v.begin());
   const T& firstVal = *res.begin();
@@ -15,10 +23,12 @@ std::list<T> parallel_quick_sort(std::list<T> v) {
                            [&](const T& x) { return x < firstVal; });
   std::list<T> low;
   low.splice(low.end(), v, v.begin(), it);
-  std::future<std::list<T>> l(
-      std::async(&parallel_quick_sort<T>, std::move(low)));
-  auto r(parallel_quick_sort(std::move(v)));
+  // 小于基准的部分可以被线程池中的其他线程窃取，线程数不随递归深度增加
+  std::list<T> l;
+  std::list<T> r;
+  parallel_invoke([&] { r = parallel_quick_sort(std::move(v)); },
+                  [&] { l = parallel_quick_sort(std::move(low)); });
   res.splice(res.end(), r);
-  res.splice(res.begin(), l.get());
+  res.splice(res.begin(), l);
   return res;
-}
\ No newline at end of file
+}
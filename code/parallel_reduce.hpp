@@ -0,0 +1,284 @@
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>  // for std::to_address
+#include <numeric>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "partitioner.hpp"
+#include "worker_team.hpp"
+
+// 求较小值、较大值的函数对象，与 std::plus<> 一起可以使用 SIMD 归约
+struct minimum {
+  template <typename T, typename U>
+  std::common_type_t<T, U> operator()(const T& a, const U& b) const {
+    return b < a ? b : a;
+  }
+};
+
+struct maximum {
+  template <typename T, typename U>
+  std::common_type_t<T, U> operator()(const T& a, const U& b) const {
+    return a < b ? b : a;
+  }
+};
+
+enum class reduce_kind { other, plus, min, max };
+
+template <typename T, typename BinaryOp>
+constexpr reduce_kind reduce_kind_of =
+    std::is_same_v<BinaryOp, std::plus<>> ||
+            std::is_same_v<BinaryOp, std::plus<T>>
+        ? reduce_kind::plus
+    : std::is_same_v<BinaryOp, minimum> ? reduce_kind::min
+    : std::is_same_v<BinaryOp, maximum> ? reduce_kind::max
+                                        : reduce_kind::other;
+
+// 编译时按指令集选择向量宽度：AVX-512、AVX2、SSE2，都没有时不使用 SIMD
+template <typename T>
+struct simd_traits {
+  static constexpr bool enabled = false;
+};
+
+#if defined(__AVX512F__)
+template <>
+struct simd_traits<float> {
+  static constexpr bool enabled = true;
+  static constexpr std::size_t width = 16;
+  using reg = __m512;
+  static reg load(const float* p) { return _mm512_loadu_ps(p); }
+  static void store(float* p, reg x) { _mm512_storeu_ps(p, x); }
+  static reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+  static reg min(reg a, reg b) { return _mm512_min_ps(a, b); }
+  static reg max(reg a, reg b) { return _mm512_max_ps(a, b); }
+};
+
+template <>
+struct simd_traits<double> {
+  static constexpr bool enabled = true;
+  static constexpr std::size_t width = 8;
+  using reg = __m512d;
+  static reg load(const double* p) { return _mm512_loadu_pd(p); }
+  static void store(double* p, reg x) { _mm512_storeu_pd(p, x); }
+  static reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+  static reg min(reg a, reg b) { return _mm512_min_pd(a, b); }
+  static reg max(reg a, reg b) { return _mm512_max_pd(a, b); }
+};
+#elif defined(__AVX2__)
+template <>
+struct simd_traits<float> {
+  static constexpr bool enabled = true;
+  static constexpr std::size_t width = 8;
+  using reg = __m256;
+  static reg load(const float* p) { return _mm256_loadu_ps(p); }
+  static void store(float* p, reg x) { _mm256_storeu_ps(p, x); }
+  static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+  static reg min(reg a, reg b) { return _mm256_min_ps(a, b); }
+  static reg max(reg a, reg b) { return _mm256_max_ps(a, b); }
+};
+
+template <>
+struct simd_traits<double> {
+  static constexpr bool enabled = true;
+  static constexpr std::size_t width = 4;
+  using reg = __m256d;
+  static reg load(const double* p) { return _mm256_loadu_pd(p); }
+  static void store(double* p, reg x) { _mm256_storeu_pd(p, x); }
+  static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+  static reg min(reg a, reg b) { return _mm256_min_pd(a, b); }
+  static reg max(reg a, reg b) { return _mm256_max_pd(a, b); }
+};
+#elif defined(__SSE2__)
+template <>
+struct simd_traits<float> {
+  static constexpr bool enabled = true;
+  static constexpr std::size_t width = 4;
+  using reg = __m128;
+  static reg load(const float* p) { return _mm_loadu_ps(p); }
+  static void store(float* p, reg x) { _mm_storeu_ps(p, x); }
+  static reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+  static reg min(reg a, reg b) { return _mm_min_ps(a, b); }
+  static reg max(reg a, reg b) { return _mm_max_ps(a, b); }
+};
+
+template <>
+struct simd_traits<double> {
+  static constexpr bool enabled = true;
+  static constexpr std::size_t width = 2;
+  using reg = __m128d;
+  static reg load(const double* p) { return _mm_loadu_pd(p); }
+  static void store(double* p, reg x) { _mm_storeu_pd(p, x); }
+  static reg add(reg a, reg b) { return _mm_add_pd(a, b); }
+  static reg min(reg a, reg b) { return _mm_min_pd(a, b); }
+  static reg max(reg a, reg b) { return _mm_max_pd(a, b); }
+};
+#endif
+
+// 一块数据的归约。std::accumulate 严格从左到右，每次加法都依赖上一次的结果，
+// 浮点数不能被编译器向量化。已知满足结合律和交换律的运算（加法、最小值、
+// 最大值）改用多个独立的累加器交错累加，最后再合并：
+// - float、double 用 K 个向量寄存器，隐藏加法的延迟，内存带宽成为瓶颈
+// - 其他算术类型用 lanes 个标量累加器，编译器可以将其向量化
+// 结合顺序因此与顺序计算不同，浮点数的结果可能有舍入误差上的差异；
+// 有 NaN 时最小值、最大值的结果与 minimum、maximum 逐个比较的结果可能不同。
+// 结果以 T 累加，T 与元素类型不同时（比如用 long long 累加 int）
+// 逐个元素转换为 T 后累加，不使用上面的方法，避免在元素类型中溢出
+template <typename Iterator, typename T, typename BinaryOp>
+struct reduce_kernel {
+  using value_type = typename std::iterator_traits<Iterator>::value_type;
+  static constexpr reduce_kind kind = reduce_kind_of<value_type, BinaryOp>;
+  static constexpr bool interleaved = std::contiguous_iterator<Iterator> &&
+                                      std::is_same_v<T, value_type> &&
+                                      std::is_arithmetic_v<value_type> &&
+                                      kind != reduce_kind::other;
+
+  template <typename S>
+  static typename S::reg apply(typename S::reg a, typename S::reg b) {
+    if constexpr (kind == reduce_kind::plus) {
+      return S::add(a, b);
+    } else if constexpr (kind == reduce_kind::min) {
+      return S::min(a, b);
+    } else {
+      return S::max(a, b);
+    }
+  }
+
+  // 返回 [p, p + n) 的归约结果，调用者保证 n 不为零
+  static value_type simd_reduce(const value_type* p, std::size_t n,
+                                BinaryOp& op) {
+    using S = simd_traits<value_type>;
+    constexpr std::size_t K = 4;
+    constexpr std::size_t step = S::width * K;
+    if (n < step) return std::accumulate(p + 1, p + n, p[0], op);
+    typename S::reg acc[K];
+    for (std::size_t j = 0; j < K; ++j) acc[j] = S::load(p + j * S::width);
+    std::size_t i = step;
+    for (; i + step <= n; i += step) {
+      for (std::size_t j = 0; j < K; ++j) {
+        acc[j] = apply<S>(acc[j], S::load(p + i + j * S::width));
+      }
+    }
+    acc[0] = apply<S>(apply<S>(acc[0], acc[1]), apply<S>(acc[2], acc[3]));
+    value_type lanes[S::width];
+    S::store(lanes, acc[0]);
+    value_type res = std::accumulate(lanes + 1, lanes + S::width, lanes[0], op);
+    return std::accumulate(p + i, p + n, res, op);
+  }
+
+  template <std::size_t lanes>
+  static value_type lane_reduce(const value_type* p, std::size_t n,
+                                BinaryOp& op) {
+    if (n < lanes) return std::accumulate(p + 1, p + n, p[0], op);
+    value_type acc[lanes];
+    std::copy(p, p + lanes, acc);
+    std::size_t i = lanes;
+    for (; i + lanes <= n; i += lanes) {
+      for (std::size_t j = 0; j < lanes; ++j) acc[j] = op(acc[j], p[i + j]);
+    }
+    value_type res = std::accumulate(acc + 1, acc + lanes, acc[0], op);
+    return std::accumulate(p + i, p + n, res, op);
+  }
+
+  static T sequential_reduce(Iterator first, Iterator last, BinaryOp& op) {
+    T res(*first);
+    return std::accumulate(++first, last, std::move(res), op);
+  }
+
+  static T reduce(Iterator first, Iterator last, BinaryOp& op) {
+    if constexpr (interleaved) {
+      const value_type* p = std::to_address(first);
+      const std::size_t n = last - first;
+      if constexpr (simd_traits<value_type>::enabled) {
+        return simd_reduce(p, n, op);
+      } else {
+        return lane_reduce<64 / sizeof(value_type)>(p, n, op);
+      }
+    } else {
+      return sequential_reduce(first, last, op);
+    }
+  }
+
+  // 结果只取决于数据，与指令集无关：累加器个数固定，合并顺序固定
+  static T reduce_reproducible(Iterator first, Iterator last, BinaryOp& op) {
+    if constexpr (interleaved) {
+      return lane_reduce<16>(std::to_address(first), last - first, op);
+    } else {
+      return sequential_reduce(first, last, op);
+    }
+  }
+};
+
+// 并行归约，op 需满足结合律。op 为 std::plus<>、minimum、maximum 且数据
+// 连续存储时，块内使用 SIMD，1 GB 的 float 数组的归约受限于内存带宽。
+// 各线程的结果按块的顺序合并，再与 init 合并
+template <typename Iterator, typename T, typename BinaryOp = std::plus<>>
+T parallel_reduce(Iterator first, Iterator last, T init,
+                  BinaryOp op = BinaryOp{},
+                  grain_cost& cost = default_grain_cost<
+                      struct parallel_reduce_tag, Iterator, BinaryOp>()) {
+  using kernel = reduce_kernel<Iterator, T, BinaryOp>;
+  const unsigned long len = std::distance(first, last);
+  if (!len) return init;
+  const partition p = make_partition(len, cost.get());
+  const unsigned long num_threads = p.num_threads;
+  const unsigned long last_len = len - p.block_size * (num_threads - 1);
+  const std::vector<Iterator> starts = block_starts(first, last, p);
+  std::vector<T> partial(num_threads);
+  worker_team::instance().parallel_region(num_threads, [&](unsigned long i) {
+    if (i + 1 < num_threads) {
+      partial[i] = kernel::reduce(starts[i], starts[i + 1], op);
+    } else {
+      partial[i] = cost.measure(
+          last_len, [&] { return kernel::reduce(starts[i], last, op); });
+    }
+  });
+  T res = std::move(init);
+  for (auto& x : partial) res = op(std::move(res), std::move(x));
+  return res;
+}
+
+// 可复现的并行归约：数据按固定大小分块，块内的结合顺序固定，
+// 各块的结果按顺序合并，因此浮点数的结果与线程数和指令集都无关，
+// 每次运行、每台机器上都相同。比 parallel_reduce 慢，但仍可向量化
+template <typename Iterator, typename T, typename BinaryOp = std::plus<>>
+T parallel_reduce_reproducible(
+    Iterator first, Iterator last, T init, BinaryOp op = BinaryOp{},
+    grain_cost& cost = default_grain_cost<
+        struct parallel_reduce_reproducible_tag, Iterator, BinaryOp>()) {
+  using kernel = reduce_kernel<Iterator, T, BinaryOp>;
+  const unsigned long len = std::distance(first, last);
+  if (!len) return init;
+  const unsigned long block_size = 1 << 14;  // 改变它会改变结果
+  const unsigned long num_blocks = (len + block_size - 1) / block_size;
+  const unsigned long num_threads =
+      std::min(make_partition(len, cost.get()).num_threads, num_blocks);
+  std::vector<T> partial(num_blocks);
+  auto reduce_blocks = [&](unsigned long b, unsigned long e) {
+    Iterator it = first;
+    std::advance(it, b * block_size);
+    for (; b < e; ++b) {
+      Iterator next = it;
+      std::advance(next, std::min(block_size, len - b * block_size));
+      partial[b] = kernel::reduce_reproducible(it, next, op);
+      it = next;
+    }
+  };
+  worker_team::instance().parallel_region(num_threads, [&](unsigned long i) {
+    const unsigned long b = num_blocks * i / num_threads;
+    const unsigned long e = num_blocks * (i + 1) / num_threads;
+    if (i + 1 < num_threads) {
+      reduce_blocks(b, e);
+    } else {
+      cost.measure(len - b * block_size, [&] { reduce_blocks(b, e); });
+    }
+  });
+  T res = std::move(init);
+  for (auto& x : partial) res = op(std::move(res), std::move(x));
+  return res;
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iterator>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "worker_team.hpp"
+
+// 创建并 join 一个线程的开销（纳秒），第一次调用时测量，取多次的中位数。
+// 每块创建一个线程的算法（例如 parallel_accumulate_exception_safe.hpp）
+// 用它代替 region_cost_ns
+inline double spawn_cost_ns() {
+  static const double res = [] {
+    std::array<double, 7> samples;
+    for (auto& x : samples) {
+      const auto start = std::chrono::steady_clock::now();
+      std::thread([] {}).join();
+      const std::chrono::duration<double, std::nano> d =
+          std::chrono::steady_clock::now() - start;
+      x = d.count();
+    }
+    std::nth_element(samples.begin(), samples.begin() + samples.size() / 2,
+                     samples.end());
+    return std::max(samples[samples.size() / 2], 1000.0);
+  }();
+  return res;
+}
+
+// 并行算法启动一次并行区的开销（纳秒）：用常驻的线程组执行一个空的
+// parallel_region，唤醒工作线程并等待它们完成。第一次调用时测量，
+// 取多次的中位数。比每次创建新线程的开销小得多，块可以相应地小一些
+inline double region_cost_ns() {
+  static const double res = [] {
+    worker_team& team = worker_team::instance();
+    const unsigned long n = team.size() + 1;
+    team.parallel_region(n, [](unsigned long) {});  // 预热
+    std::array<double, 15> samples;
+    for (auto& x : samples) {
+      const auto start = std::chrono::steady_clock::now();
+      team.parallel_region(n, [](unsigned long) {});
+      const std::chrono::duration<double, std::nano> d =
+          std::chrono::steady_clock::now() - start;
+      x = d.count();
+    }
+    std::nth_element(samples.begin(), samples.begin() + samples.size() / 2,
+                     samples.end());
+    return std::max(samples[samples.size() / 2], 500.0);
+  }();
+  return res;
+}
+
+// 一个调用点处理每个元素的耗时（纳秒），用指数加权移动平均跟踪实测值。
+// 可以传入估计值作为提示，没有提示也没有测量过时按每个元素 1 纳秒估计
+class grain_cost {
+  static constexpr double alpha = 0.25;  // 新样本的权重
+  std::atomic<double> ns_per_element;
+  std::atomic<bool> measured{false};
+
+ public:
+  explicit grain_cost(double hint_ns = 0)
+      : ns_per_element(hint_ns > 0 ? hint_ns : 1.0) {}
+  grain_cost(const grain_cost&) = delete;
+  grain_cost& operator=(const grain_cost&) = delete;
+
+  double get() const { return ns_per_element.load(std::memory_order_relaxed); }
+
+  // 并发调用时可能丢失一个样本，对估计值没有影响，因此不需要 CAS
+  void record(unsigned long n, std::chrono::nanoseconds d) {
+    if (!n) return;
+    const double sample = static_cast<double>(d.count()) / n;
+    const double old = get();
+    ns_per_element.store(
+        measured.exchange(true, std::memory_order_relaxed)
+            ? old + alpha * (sample - old)
+            : sample,
+        std::memory_order_relaxed);
+  }
+
+  // 调用 f() 并把耗时记为 n 个元素的样本，f 抛出异常时不记录
+  template <typename F>
+  decltype(auto) measure(unsigned long n, F&& f) {
+    const auto start = std::chrono::steady_clock::now();
+    if constexpr (std::is_void_v<std::invoke_result_t<F>>) {
+      std::forward<F>(f)();
+      record(n, std::chrono::steady_clock::now() - start);
+    } else {
+      decltype(auto) res = std::forward<F>(f)();
+      record(n, std::chrono::steady_clock::now() - start);
+      return res;
+    }
+  }
+};
+
+// 并行算法的最后一个参数 cost 默认取这里的对象：第一个模板参数区分算法，
+// 其余的区分实例化（传入 lambda 时通常对应一个调用点）。调用者也可以传入
+// 自己的 grain_cost，例如 static grain_cost cost(200); 提示每个元素 200 纳秒
+template <typename... Tag>
+grain_cost& default_grain_cost() {
+  static grain_cost res;
+  return res;
+}
+
+// 一块的耗时至少为启动开销的这么多倍，启动开销占比不超过约 1/4
+constexpr double overhead_factor = 4;
+
+// 值得交给一个线程的最少元素数。overhead_ns 为把工作交给线程的开销，
+// 默认为 worker_team 的并行区
+inline unsigned long grain_size(double ns_per_element,
+                                double overhead_ns = region_cost_ns()) {
+  const double res =
+      overhead_ns * overhead_factor / std::max(ns_per_element, 1e-3);
+  return std::max(1ul,
+                  static_cast<unsigned long>(std::ceil(std::min(res, 1e12))));
+}
+
+// 可取消的算法大约每隔这么长时间（纳秒）检查一次是否应该停止
+constexpr double check_interval_ns = 2000;
+
+// 两次检查之间处理的元素数：元素开销小时一次处理很多个，检查的开销可以忽略；
+// 开销大时每个元素都检查，停止后几微秒内不再占用 CPU
+inline unsigned long check_interval(double ns_per_element) {
+  const double res = check_interval_ns / std::max(ns_per_element, 1e-3);
+  return std::max(1ul, static_cast<unsigned long>(std::min(res, 1e6)));
+}
+
+struct partition {
+  unsigned long num_threads;  // 为 1 时顺序执行
+  unsigned long block_size;
+};
+
+// 根据元素数和每个元素的耗时决定线程数和块大小：每块至少 grain_size 个元素，
+// 线程数不超过硬件线程数
+inline partition make_partition(unsigned long len, double ns_per_element,
+                                double overhead_ns = region_cost_ns()) {
+  const unsigned long min_per_thread = grain_size(ns_per_element, overhead_ns);
+  const unsigned long max_threads =
+      std::max(1ul, (len + min_per_thread - 1) / min_per_thread);
+  const unsigned long hardware_threads = std::thread::hardware_concurrency();
+  const unsigned long num_threads =
+      std::min(hardware_threads != 0 ? hardware_threads : 2, max_threads);
+  return {num_threads, len / num_threads};
+}
+
+// 各块的起点，共 num_threads + 1 个，最后一个为 last
+template <typename Iterator>
+std::vector<Iterator> block_starts(Iterator first, Iterator last,
+                                   const partition& p) {
+  std::vector<Iterator> res(p.num_threads + 1, first);
+  for (unsigned long i = 1; i < p.num_threads; ++i) {
+    res[i] = std::next(res[i - 1], p.block_size);
+  }
+  res[p.num_threads] = last;
+  return res;
+}
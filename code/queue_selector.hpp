@@ -0,0 +1,78 @@
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "event_count.hpp"
+
+// 让一个线程同时等待多个队列，不再需要每个队列一个转发线程
+// Queue 需要提供 try_pop() 返回指针类型的结果，以及 set_notifier(event_count*)
+// 所有 add 调用应在开始等待之前完成，一个队列同时只能注册到一个 selector。
+// 队列的 push 应在持有锁时通知 event_count，set_notifier 也获取这个锁，
+// 这样析构时 set_notifier(nullptr) 返回后不会再有 push 访问 ec
+template <typename Queue>
+class queue_selector {
+  using value_ptr = decltype(std::declval<Queue&>().try_pop());
+
+  event_count ec;
+  std::vector<Queue*> queues;
+  std::atomic<std::size_t> next{0};  // 轮询起点，避免前面的队列饿死后面的
+
+  value_ptr poll(std::size_t* index) {
+    const std::size_t n = queues.size();
+    const std::size_t start = next.fetch_add(1, std::memory_order_relaxed);
+    for (std::size_t i = 0; i < n; ++i) {
+      const std::size_t j = (start + i) % n;
+      if (value_ptr res = queues[j]->try_pop()) {
+        if (index) *index = j;
+        return res;
+      }
+    }
+    return value_ptr();
+  }
+
+ public:
+  queue_selector() = default;
+  queue_selector(const queue_selector&) = delete;
+  queue_selector& operator=(const queue_selector&) = delete;
+  ~queue_selector() {
+    for (auto x : queues) x->set_notifier(nullptr);
+  }
+
+  std::size_t add(Queue& q) {  // 返回队列的索引
+    q.set_notifier(&ec);
+    queues.push_back(&q);
+    return queues.size() - 1;
+  }
+
+  value_ptr try_pop(std::size_t* index = nullptr) { return poll(index); }
+
+  value_ptr wait_and_pop(std::size_t* index = nullptr) {
+    for (;;) {
+      if (value_ptr res = poll(index)) return res;
+      const auto key = ec.prepare_wait();
+      if (value_ptr res = poll(index)) {
+        ec.cancel_wait();
+        return res;
+      }
+      ec.commit_wait(key);
+    }
+  }
+
+  template <typename Rep, typename Period>
+  value_ptr wait_and_pop_for(  // 超时返回空指针
+      const std::chrono::duration<Rep, Period>& timeout,
+      std::size_t* index = nullptr) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    for (;;) {
+      if (value_ptr res = poll(index)) return res;
+      const auto key = ec.prepare_wait();
+      if (value_ptr res = poll(index)) {
+        ec.cancel_wait();
+        return res;
+      }
+      if (!ec.commit_wait_until(key, deadline)) return poll(index);
+    }
+  }
+};
@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "cpu_relax.hpp"
+
+// 几种自旋锁，都满足 Lockable（lock、try_lock、unlock），
+// 可以用于 std::scoped_lock、thread_safe_queue 和 thread_safe_lookup_table
+
+// 自旋等待的退避：先用 pause 指数退避，等待较久后让出时间片，
+// 避免持有锁的线程被调度出去时其他线程空转
+class backoff {
+  static constexpr unsigned max_pause = 1024;
+  unsigned n = 1;
+
+ public:
+  void operator()() {
+    if (n <= max_pause) {
+      for (unsigned i = 0; i < n; ++i) cpu_relax();
+      n *= 2;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+};
+
+// test-and-test-and-set：等待时只读锁所在的缓存行，锁释放后才尝试写，
+// 失败后指数退避，减少多个核心同时争抢
+class ttas_lock {
+  std::atomic<bool> locked{false};
+
+ public:
+  void lock() {
+    backoff b;
+    while (locked.exchange(true, std::memory_order_acquire)) {
+      do {
+        b();
+      } while (locked.load(std::memory_order_relaxed));
+    }
+  }
+  bool try_lock() {
+    return !locked.load(std::memory_order_relaxed) &&
+           !locked.exchange(true, std::memory_order_acquire);
+  }
+  void unlock() { locked.store(false, std::memory_order_release); }
+};
+
+// 排号锁：按取号顺序获得锁，保证先来先服务。
+// 等待时按前面还有几个人退避，越靠后的线程读得越少
+class ticket_lock {
+  alignas(64) std::atomic<unsigned> next{0};
+  alignas(64) std::atomic<unsigned> serving{0};
+
+ public:
+  void lock() {
+    const unsigned my = next.fetch_add(1, std::memory_order_relaxed);
+    for (unsigned spins = 0;; ++spins) {
+      const unsigned s = serving.load(std::memory_order_acquire);
+      if (s == my) return;
+      if (spins > 64) {
+        std::this_thread::yield();
+      } else {
+        for (unsigned i = (my - s) * 32; i > 0; --i) cpu_relax();
+      }
+    }
+  }
+  bool try_lock() {
+    unsigned s = serving.load(std::memory_order_relaxed);
+    return next.compare_exchange_strong(s, s + 1, std::memory_order_acquire,
+                                        std::memory_order_relaxed);
+  }
+  void unlock() {
+    serving.store(serving.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_release);
+  }
+};
+
+// MCS 队列锁：等待的线程排成链表，每个线程只在自己的节点上自旋，
+// 释放锁时只写后继的节点，锁的交接只涉及两个核心，且先来先服务。
+// 为满足 Lockable 接口，节点取自每个线程的节点池，持有者的节点记在锁中
+class mcs_lock {
+  struct alignas(64) node {
+    std::atomic<node*> next{nullptr};
+    std::atomic<bool> locked{false};
+  };
+
+  static std::vector<std::unique_ptr<node>>& pool() {  // 本线程的空闲节点
+    thread_local std::vector<std::unique_ptr<node>> p;
+    return p;
+  }
+
+  static node* acquire_node() {
+    auto& p = pool();
+    if (p.empty()) return new node;  // 用完后放入节点池，线程退出时释放
+    node* n = p.back().release();
+    p.pop_back();
+    return n;
+  }
+
+  static void release_node(node* n) { pool().emplace_back(n); }
+
+  alignas(64) std::atomic<node*> tail{nullptr};
+  node* holder = nullptr;  // 只由持有锁的线程读写
+
+ public:
+  void lock() {
+    node* n = acquire_node();
+    n->next.store(nullptr, std::memory_order_relaxed);
+    n->locked.store(true, std::memory_order_relaxed);
+    if (node* pred = tail.exchange(n, std::memory_order_acq_rel)) {
+      pred->next.store(n, std::memory_order_release);
+      backoff b;
+      while (n->locked.load(std::memory_order_acquire)) b();
+    }
+    holder = n;
+  }
+  bool try_lock() {
+    node* n = acquire_node();
+    n->next.store(nullptr, std::memory_order_relaxed);
+    node* expected = nullptr;
+    if (!tail.compare_exchange_strong(expected, n, std::memory_order_acquire,
+                                      std::memory_order_relaxed)) {
+      release_node(n);
+      return false;
+    }
+    holder = n;
+    return true;
+  }
+  void unlock() {
+    node* n = holder;
+    node* succ = n->next.load(std::memory_order_acquire);
+    if (!succ) {
+      node* expected = n;
+      if (tail.compare_exchange_strong(expected, nullptr,
+                                       std::memory_order_release,
+                                       std::memory_order_relaxed)) {
+        release_node(n);
+        return;
+      }
+      backoff b;  // 后继已加入队列但还没链接到 n 上
+      while (!(succ = n->next.load(std::memory_order_acquire))) b();
+    }
+    succ->locked.store(false, std::memory_order_release);
+    release_node(n);
+  }
+};
+
+// 先自旋一小段时间，仍未获得锁则在 std::atomic::wait 上休眠
+// （Linux 上为 futex）。状态：0 未加锁，1 已加锁，
+// 2 已加锁且可能有线程在休眠，只有此时 unlock 才需要唤醒
+class hybrid_mutex {
+  static constexpr unsigned spin_limit = 100;
+  std::atomic<int> state{0};
+
+ public:
+  void lock() {
+    for (unsigned i = 0; i < spin_limit; ++i) {
+      int expected = 0;
+      if (state.load(std::memory_order_relaxed) == 0 &&
+          state.compare_exchange_weak(expected, 1, std::memory_order_acquire,
+                                      std::memory_order_relaxed)) {
+        return;
+      }
+      cpu_relax();
+    }
+    // 标记为有等待者后休眠，醒来后同样以 2 重新获取，保证不会漏掉唤醒
+    while (state.exchange(2, std::memory_order_acquire) != 0) state.wait(2);
+  }
+  bool try_lock() {
+    int expected = 0;
+    return state.compare_exchange_strong(expected, 1, std::memory_order_acquire,
+                                         std::memory_order_relaxed);
+  }
+  void unlock() {
+    if (state.exchange(0, std::memory_order_release) == 2) state.notify_one();
+  }
+};
+
+// 把独占锁包装为读写锁的接口，lock_shared 与 lock 相同，
+// 用于 thread_safe_lookup_table 的 Mutex 参数
+template <typename Mutex>
+class exclusive_as_shared : public Mutex {
+ public:
+  void lock_shared() { this->lock(); }
+  bool try_lock_shared() { return this->try_lock(); }
+  void unlock_shared() { this->unlock(); }
+};
@@ -0,0 +1,66 @@
+// 各种锁在 1 ~ 64 个线程争抢时的吞吐量和公平性。
+// 每个线程反复加锁并修改共享计数，公平性用 Jain 指数衡量：
+// (Σx)² / (n·Σx²)，各线程获得锁的次数相同时为 1，越不公平越接近 1/n
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "lock_based_queue.hpp"
+#include "lock_based_lookup_table.hpp"
+#include "spin_locks.hpp"
+
+template <typename Mutex>
+void contention(const char* name, unsigned threads) {
+  Mutex m;
+  long shared_counter = 0;
+  std::atomic<bool> stop(false);
+  std::vector<long> counts(threads);
+  std::vector<std::thread> v;
+  for (unsigned i = 0; i < threads; ++i) {
+    v.emplace_back([&, i] {
+      long n = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        std::scoped_lock l(m);
+        ++shared_counter;
+        ++n;
+      }
+      counts[i] = n;
+    });
+  }
+  const auto d = std::chrono::milliseconds(200);
+  std::this_thread::sleep_for(d);
+  stop = true;
+  for (auto& x : v) x.join();
+  double sum = 0, sum_sq = 0;
+  for (long x : counts) {
+    sum += x;
+    sum_sq += double(x) * x;
+  }
+  std::printf("%-14s %8u %16.0f %10.3f\n", name, threads,
+              sum / std::chrono::duration<double>(d).count(),
+              sum_sq ? sum * sum / (threads * sum_sq) : 0.0);
+}
+
+int main() {
+  // 确认都可以作为队列和查找表的锁使用
+  thread_safe_queue<int, mcs_lock> q;
+  q.push(1);
+  q.wait_and_pop();
+  thread_safe_lookup_table<int, int, std::hash<int>, std::equal_to<int>,
+                           exclusive_as_shared<ttas_lock>>
+      t;
+  t.add_or_update_mapping(1, 1);
+
+  std::printf("%-14s %8s %16s %10s\n", "lock", "threads", "ops/s",
+              "fairness");
+  for (unsigned threads : {1, 2, 4, 8, 16, 32, 64}) {
+    contention<std::mutex>("std::mutex", threads);
+    contention<ttas_lock>("ttas_lock", threads);
+    contention<ticket_lock>("ticket_lock", threads);
+    contention<mcs_lock>("mcs_lock", threads);
+    contention<hybrid_mutex>("hybrid_mutex", threads);
+  }
+}
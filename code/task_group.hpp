@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <stop_token>
+#include <utility>
+
+#include "interruptible_thread.hpp"
+#include "task_pool.hpp"
+
+// fork-join 的任务组：run 把任务放入线程池，wait 等待组内所有任务完成。
+// 等待时执行池中不浅于本组的任务（优先执行自己刚放入、尚未被窃取的任务），
+// 因此递归地划分任务不会耗尽线程，线程数总是线程池的大小；
+// 没有这样的任务时休眠，直到组内最后一个任务完成。
+// 任务抛出的第一个异常在 wait 中重新抛出。
+// cancel 或任务抛出异常后，尚未开始的任务不再执行。任务执行时当前线程的
+// stop_token 是组的 token，任务内创建的组随之取消，任务可以在分块之间检查它；
+// 组创建时当前线程的 stop_token 被请求停止时，组也随之取消
+class task_group {
+  struct cancel_on_stop {
+    std::stop_source* source;
+    void operator()() const noexcept { source->request_stop(); }
+  };
+
+  task_pool& pool;
+  const unsigned depth;  // 创建时所在任务的深度加一
+  std::atomic<unsigned> pending{0};
+  std::atomic<bool> skipped{false};  // 是否有任务因取消而没有执行
+  std::mutex m;
+  std::exception_ptr error;
+  std::stop_source source;
+  std::stop_callback<cancel_on_stop> parent_link;  // 在 source 之后构造
+
+  void join() {
+    pool.help_until(depth, [this] {
+      return !pending.load(std::memory_order_acquire);
+    });
+  }
+
+ public:
+  explicit task_group(task_pool& p = task_pool::instance())
+      : task_group(this_thread_stop_token, p) {}
+  explicit task_group(std::stop_token parent,
+                      task_pool& p = task_pool::instance())
+      : pool(p),
+        depth(task_pool::task_depth() + 1),
+        parent_link(std::move(parent), cancel_on_stop{&source}) {}
+  task_group(const task_group&) = delete;
+  task_group& operator=(const task_group&) = delete;
+  ~task_group() { join(); }  // 任务引用了组，必须在析构前完成
+
+  template <typename F>
+  void run(F f) {
+    pending.fetch_add(1, std::memory_order_relaxed);
+    pool.submit([this, f = std::move(f)]() mutable {
+      if (source.stop_requested()) {
+        skipped.store(true, std::memory_order_relaxed);
+      } else {
+        stop_token_scope scope(source.get_token());
+        try {
+          f();
+        } catch (const thread_interrupted&) {  // 组已取消，不算错误
+          skipped.store(true, std::memory_order_relaxed);
+        } catch (...) {
+          std::lock_guard<std::mutex> l(m);
+          if (!error) error = std::current_exception();
+          source.request_stop();
+        }
+      }
+      task_pool& p = pool;  // 计数归零后组可能已经析构
+      if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) p.notify();
+    }, depth);
+  }
+
+  void cancel() noexcept { source.request_stop(); }
+  bool is_canceling() const noexcept { return source.stop_requested(); }
+  std::stop_token get_token() const noexcept { return source.get_token(); }
+
+  // 返回 false 表示组被取消，有任务没有执行完
+  bool wait() {
+    join();
+    if (error) std::rethrow_exception(std::exchange(error, nullptr));
+    return !skipped.exchange(false, std::memory_order_relaxed);
+  }
+};
+
+// 并行执行 f 和 rest：rest 放入线程池供其他线程窃取，f 直接在当前线程执行，
+// 之后若 rest 未被窃取就由当前线程自己执行。全部完成后返回，
+// 有异常时抛出第一个；当前线程的 stop_token 被请求停止而 rest 没有执行时，
+// 抛出 thread_interrupted。f 与 rest 一样在组的 stop_token 下执行，
+// rest 抛出异常时 f 及其中创建的组也随之取消
+template <typename F, typename... Fs>
+void parallel_invoke(F&& f, Fs&&... rest) {
+  task_group g;
+  (g.run([&rest] { rest(); }), ...);
+  try {
+    stop_token_scope scope(g.get_token());
+    f();
+  } catch (const thread_interrupted&) {
+    g.wait();  // 取消可能是 rest 的异常引起的，优先抛出它
+    throw;
+  } catch (...) {
+    try {
+      g.wait();  // rest 引用了调用者的数据，必须等它们完成
+    } catch (...) {  // 优先抛出 f 的异常
+    }
+    throw;
+  }
+  if (!g.wait()) throw thread_interrupted();
+}
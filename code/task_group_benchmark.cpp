@@ -0,0 +1,44 @@
+// 递归二分 depth 层：parallel_invoke 与每次划分都用 std::async 创建线程对比
+#include <chrono>
+#include <cstdio>
+#include <future>
+
+#include "task_group.hpp"
+
+long leaf(int i) {  // 每个叶子的少量计算
+  long h = i;
+  for (int j = 0; j < 1000; ++j) h = h * 6364136223846793005L + 1;
+  return h & 1;
+}
+
+long with_tasks(int depth, int i) {
+  if (!depth) return leaf(i);
+  long a = 0;
+  long b = 0;
+  parallel_invoke([&] { a = with_tasks(depth - 1, i * 2); },
+                  [&] { b = with_tasks(depth - 1, i * 2 + 1); });
+  return a + b;
+}
+
+long with_async(int depth, int i) {
+  if (!depth) return leaf(i);
+  std::future<long> b =
+      std::async(std::launch::async, with_async, depth - 1, i * 2 + 1);
+  const long a = with_async(depth - 1, i * 2);
+  return a + b.get();
+}
+
+template <typename F>
+void run(const char* name, F f) {
+  const auto start = std::chrono::steady_clock::now();
+  const long res = f();
+  const std::chrono::duration<double, std::milli> d =
+      std::chrono::steady_clock::now() - start;
+  std::printf("%-14s %10.3f ms  (%ld)\n", name, d.count(), res);
+}
+
+int main() {
+  const int depth = 12;
+  run("std::async", [&] { return with_async(depth, 0); });
+  run("task_group", [&] { return with_tasks(depth, 0); });
+}
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "cpu_relax.hpp"
+#include "event_count.hpp"
+#include "function_wrapper.hpp"
+
+// 每个任务带有深度，即提交它的 task_group 的嵌套层数，见 task_pool::help_until
+class work_stealing_queue {
+ public:
+  struct entry {
+    function_wrapper task;
+    unsigned depth = 0;
+  };
+
+ private:
+  std::deque<entry> q;
+  mutable std::mutex m;
+
+ public:
+  work_stealing_queue() = default;
+  work_stealing_queue(const work_stealing_queue&) = delete;
+  work_stealing_queue& operator=(const work_stealing_queue&) = delete;
+
+  void push(function_wrapper x, unsigned depth) {
+    std::lock_guard<std::mutex> l(m);
+    q.push_front({std::move(x), depth});
+  }
+
+  bool has_task(unsigned min_depth) const {  // 有没有不浅于 min_depth 的任务
+    std::lock_guard<std::mutex> l(m);
+    return std::any_of(q.begin(), q.end(),
+                       [&](const entry& x) { return x.depth >= min_depth; });
+  }
+
+  // 本线程从前端取出最新的、深度不小于 min_depth 的任务
+  bool try_pop(entry& res, unsigned min_depth) {
+    std::lock_guard<std::mutex> l(m);
+    const auto it = std::find_if(q.begin(), q.end(), [&](const entry& x) {
+      return x.depth >= min_depth;
+    });
+    if (it == q.end()) return false;
+    res = std::move(*it);
+    q.erase(it);
+    return true;
+  }
+
+  // 其他线程从后端取出最旧的、深度不小于 min_depth 的任务
+  bool try_steal(entry& res, unsigned min_depth) {
+    std::lock_guard<std::mutex> l(m);
+    const auto it = std::find_if(q.rbegin(), q.rend(), [&](const entry& x) {
+      return x.depth >= min_depth;
+    });
+    if (it == q.rend()) return false;
+    res = std::move(*it);
+    q.erase(std::next(it).base());
+    return true;
+  }
+};
+
+// 固定数量工作线程的任务窃取线程池，进程中唯一的一组工作线程：
+// task_group 向它提交任务，worker_team 的并行区预约它的空闲线程。
+// 工作线程提交的任务放入自己的队列，其他线程提交的放入公共队列；
+// 没有任务时工作线程在 event_count 上休眠，不会空转
+class task_pool {
+ public:
+  // 预约空闲工作线程执行的工作，被预约的线程调用 run(this)
+  struct job {
+    void (*run)(job*);
+  };
+
+ private:
+  using entry = work_stealing_queue::entry;
+
+  struct alignas(64) slot {  // 每个工作线程一个
+    std::atomic<job*> reserved{nullptr};  // 为 &idle 时线程空闲，可以预约
+  };
+
+  static inline job idle{};
+  std::atomic<bool> done{false};
+  event_count ec;
+  work_stealing_queue pool_work_queue;  // 从后端取出，先进先出
+  std::vector<std::unique_ptr<work_stealing_queue>> queues;
+  std::unique_ptr<slot[]> slots;
+  std::vector<std::thread> threads;
+  static inline thread_local task_pool* current_pool = nullptr;
+  static inline thread_local unsigned my_index = 0;
+  static inline thread_local unsigned current_depth = 0;
+
+  work_stealing_queue* local_work_queue() const {
+    return current_pool == this ? queues[my_index].get() : nullptr;
+  }
+
+  bool pop_task_from_local_queue(entry& task, unsigned min_depth) {
+    work_stealing_queue* q = local_work_queue();
+    return q && q->try_pop(task, min_depth);
+  }
+
+  bool pop_task_from_pool_queue(entry& task, unsigned min_depth) {
+    return pool_work_queue.try_steal(task, min_depth);
+  }
+
+  bool pop_task_from_other_thread_queue(entry& task, unsigned min_depth) {
+    const unsigned start = current_pool == this ? my_index + 1 : 0;
+    for (unsigned i = 0; i < queues.size(); ++i) {
+      const unsigned index = (start + i) % queues.size();
+      if (queues[index]->try_steal(task, min_depth)) return true;
+    }
+    return false;
+  }
+
+  bool has_work(unsigned min_depth) const {
+    if (pool_work_queue.has_task(min_depth)) return true;
+    for (auto& x : queues) {
+      if (x->has_task(min_depth)) return true;
+    }
+    return false;
+  }
+
+  // 没有可执行的任务时先自旋一小段时间，再在 event_count 上休眠，
+  // 直到 ready() 成立或有深度不小于 min_depth 的任务
+  template <typename Predicate>
+  void wait_for_work(unsigned min_depth, Predicate ready) {
+    // 单核时自旋只会推迟其他线程
+    static const int spins = std::thread::hardware_concurrency() > 1 ? 128 : 0;
+    for (int i = 0; i < spins && !ready(); ++i) cpu_relax();
+    const auto key = ec.prepare_wait();
+    if (ready() || has_work(min_depth)) {
+      ec.cancel_wait();
+    } else {
+      ec.commit_wait(key);
+    }
+  }
+
+  // 空闲时标记为可预约。被预约的线程只执行预约它的工作，不会同时在执行
+  // 某个任务，因此预约到的线程可以立即开始，并行区的成员可以互相等待
+  void worker_thread(unsigned index) {
+    current_pool = this;
+    my_index = index;
+    std::atomic<job*>& reserved = slots[index].reserved;
+    while (!done.load()) {
+      if (run_pending_task()) continue;
+      reserved.store(&idle);
+      wait_for_work(0, [&] { return done.load() || reserved.load() != &idle; });
+      job* j = reserved.exchange(nullptr);  // 不再可以预约
+      if (j != &idle) j->run(j);
+    }
+  }
+
+ public:
+  explicit task_pool(unsigned n) : slots(new slot[n]) {
+    try {
+      for (unsigned i = 0; i < n; ++i) {
+        queues.emplace_back(std::make_unique<work_stealing_queue>());
+      }
+      for (unsigned i = 0; i < n; ++i) {
+        threads.emplace_back(&task_pool::worker_thread, this, i);
+      }
+    } catch (...) {
+      shutdown();
+      throw;
+    }
+  }
+  task_pool(const task_pool&) = delete;
+  task_pool& operator=(const task_pool&) = delete;
+  ~task_pool() { shutdown(); }
+
+  // 进程共享的线程池，工作线程数为硬件线程数减一（等待的线程也会执行任务，
+  // 调用 parallel_region 的线程也是并行区的成员）
+  static task_pool& instance() {
+    static task_pool res([] {
+      const unsigned n = std::thread::hardware_concurrency();
+      return n > 1 ? n - 1 : 1;
+    }());
+    return res;
+  }
+
+  unsigned long size() const { return threads.size(); }
+
+  // 当前线程正在执行的任务的深度，不在任务中时为零
+  static unsigned task_depth() { return current_depth; }
+
+  void submit(function_wrapper task, unsigned depth) {
+    if (work_stealing_queue* q = local_work_queue()) {
+      q->push(std::move(task), depth);
+    } else {
+      pool_work_queue.push(std::move(task), depth);
+    }
+    ec.notify_all();
+  }
+
+  // 执行一个深度不小于 min_depth 的任务，没有这样的任务时返回 false
+  bool run_pending_task(unsigned min_depth = 0) {
+    entry task;
+    if (pop_task_from_local_queue(task, min_depth) ||
+        pop_task_from_pool_queue(task, min_depth) ||
+        pop_task_from_other_thread_queue(task, min_depth)) {
+      const unsigned saved = std::exchange(current_depth, task.depth);
+      task.task();
+      current_depth = saved;
+      return true;
+    }
+    return false;
+  }
+
+  // 执行任务直到 done() 成立，没有可执行的任务时先自旋一小段时间，
+  // 再在 event_count 上休眠。使 done() 成立的线程之后要调用 notify。
+  // 等待组的线程只执行深度不小于该组的任务（与 TBB 相同）：更浅的任务与
+  // 这个组无关，它们又会等待自己的组、执行其他任务，栈随任务数增长，
+  // 这个组完成后也要等它们执行完才能返回。组每嵌套一层深度加一，
+  // 栈的深度因此不超过组的嵌套层数
+  template <typename Predicate>
+  void help_until(unsigned min_depth, Predicate done) {
+    while (!done()) {
+      if (!run_pending_task(min_depth)) wait_for_work(min_depth, done);
+    }
+  }
+
+  void notify() { ec.notify_all(); }
+
+  // 预约最多 n 个空闲的工作线程，各自执行 j->run(j)，返回预约到的线程数
+  unsigned long reserve(job* j, unsigned long n) {
+    unsigned long res = 0;
+    for (unsigned long i = 0; i < threads.size() && res < n; ++i) {
+      job* expected = &idle;
+      if (slots[i].reserved.load(std::memory_order_relaxed) == expected &&
+          slots[i].reserved.compare_exchange_strong(expected, j)) {
+        ++res;
+      }
+    }
+    if (res) ec.notify_all();
+    return res;
+  }
+
+ private:
+  void shutdown() {
+    done = true;
+    ec.notify_all();
+    for (auto& x : threads) {
+      if (x.joinable()) x.join();
+    }
+  }
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+// 给每个线程分配一个从 0 开始的小整数编号，线程退出后编号回收给新线程，
+// 因此编号的最大值约等于同时存在的线程数，可以用来索引按线程划分的数组
+class thread_index {
+  struct registry {
+    std::mutex m;
+    std::vector<unsigned> free;  // 已退出线程的编号
+    unsigned next = 0;
+  };
+
+  static registry& get_registry() {
+    static registry r;  // 在所有线程的 holder 之前构造，之后析构
+    return r;
+  }
+
+  struct holder {
+    unsigned id;
+    holder() {
+      registry& r = get_registry();
+      std::lock_guard<std::mutex> l(r.m);
+      if (r.free.empty()) {
+        id = r.next++;
+      } else {
+        id = r.free.back();
+        r.free.pop_back();
+      }
+    }
+    ~holder() {
+      registry& r = get_registry();
+      std::lock_guard<std::mutex> l(r.m);
+      r.free.push_back(id);
+    }
+  };
+
+ public:
+  static unsigned get() {
+    thread_local holder h;
+    return h.id;
+  }
+};
@@ -0,0 +1,35 @@
+// 每次调用的开销：常驻线程组的 parallel_region 与每次创建、join 新线程对比
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "threads_guard.hpp"
+#include "worker_team.hpp"
+
+template <typename F>
+double us_per_call(int rounds, F f) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; ++i) f();
+  const std::chrono::duration<double, std::micro> d =
+      std::chrono::steady_clock::now() - start;
+  return d.count() / rounds;
+}
+
+int main() {
+  const unsigned long hw = std::thread::hardware_concurrency();
+  const unsigned long n = hw > 1 ? hw : 2;
+  const int rounds = 2000;
+  worker_team& team = worker_team::instance();
+  const double fresh = us_per_call(rounds, [&] {
+    std::vector<std::thread> threads(n - 1);
+    threads_guard g(threads);
+    for (auto& x : threads) x = std::thread([] {});
+  });
+  team.parallel_region(n, [](unsigned long) {});  // 预热
+  const double pooled = us_per_call(
+      rounds, [&] { team.parallel_region(n, [](unsigned long) {}); });
+  std::printf("threads: %lu\n", n);
+  std::printf("new threads   %10.2f us/call\n", fresh);
+  std::printf("worker_team   %10.2f us/call\n", pooled);
+}